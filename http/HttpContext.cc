@@ -1,33 +1,95 @@
 #include "muduo/include/net/Buffer.h"
 #include "http/HttpContext.h"
+#include "http/HttpTokenizer.h"
 #include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
 using namespace muduo;
 using namespace muduo::net;
 
-bool HttpContext::processRequestLine(const char* begin, const char* end) // 解析请求行
+namespace
+{
+
+/// 十进制的Content-Length, 只允许数字
+bool parseContentLength(StringPiece value, size_t* length)
+{
+  if (value.empty() || value.size() > 18)
+  {
+    return false;
+  }
+  size_t n = 0;
+  for (const char* p = value.begin(); p != value.end(); ++p)
+  {
+    char c = *p;
+    if (c < '0' || c > '9')
+    {
+      return false;
+    }
+    n = n * 10 + static_cast<size_t>(c - '0');
+  }
+  *length = n;
+  return true;
+}
+
+/// chunk-size [; chunk-ext], 十六进制, 扩展忽略
+bool parseChunkSize(const char* begin, const char* end, size_t* size)
+{
+  size_t n = 0;
+  const char* p = begin;
+  for (; p != end && p - begin < 15; ++p)
+  {
+    int digit;
+    if (*p >= '0' && *p <= '9')
+    {
+      digit = *p - '0';
+    }
+    else if (*p >= 'a' && *p <= 'f')
+    {
+      digit = *p - 'a' + 10;
+    }
+    else if (*p >= 'A' && *p <= 'F')
+    {
+      digit = *p - 'A' + 10;
+    }
+    else
+    {
+      break;
+    }
+    n = n * 16 + static_cast<size_t>(digit);
+  }
+  if (p == begin || (p != end && *p != ';' && *p != ' ' && *p != '\t'))
+  {
+    return false;
+  }
+  *size = n;
+  return true;
+}
+
+}  // namespace
+
+bool HttpContext::processRequestLine(const char* base, const char* begin, const char* end) // 解析请求行
 {
   bool succeed = false;
   const char* start = begin;
   const char* space = std::find(start, end, ' ');
   /// 可以解析出Method
-  if (space != end && request_.setMethod(start, space))
+  if (space != end && (view_.method_ = HttpRequest::parseMethod(start, space)) != HttpRequest::kInvalid)
   {
     start = space+1;
-    space = std::find(start, end, ' ');
+    /// 请求目标, 同时检查其中没有控制字符
+    space = HttpTokenizer::scanTarget(start, end);
 
     /// 解析出path
-    if (space != end)
+    if (space != NULL && space != end)
     {
-      const char* question = std::find(start, space, '?');
-      if (question != space)
-      {
-        request_.setPath(start, question);
-        request_.setQuery(question, space);
-      }
-      else
+      const char* question = static_cast<const char*>(memchr(start, '?', static_cast<size_t>(space - start)));
+      if (question == NULL)
       {
-        request_.setPath(start, space);
+        question = space;
       }
+      view_.path_ = HttpRequestView::token(base, start, question);
+      view_.query_ = HttpRequestView::token(base, question, space);
       start = space+1;
 
       /// 解析http版本
@@ -36,11 +98,11 @@ bool HttpContext::processRequestLine(const char* begin, const char* end) // 解
       {
         if (*(end-1) == '1')
         {
-          request_.setVersion(HttpRequest::kHttp11);
+          view_.version_ = HttpRequest::kHttp11;
         }
         else if (*(end-1) == '0')
         {
-          request_.setVersion(HttpRequest::kHttp10);
+          view_.version_ = HttpRequest::kHttp10;
         }
         else
         {
@@ -52,6 +114,29 @@ bool HttpContext::processRequestLine(const char* begin, const char* end) // 解
   return succeed;
 }
 
+bool HttpContext::processHeader(const char* base, const char* begin, const char* colon, const char* end)
+{
+  if (view_.numHeaders_ == HttpRequestView::kMaxHeaders)
+  {
+    return false;
+  }
+  /// 去掉value首尾的空白, 分词时已经排除了其他控制字符, 只剩空格和HTAB
+  const char* value = colon + 1;
+  while (value < end && (*value == ' ' || *value == '\t'))
+  {
+    ++value;
+  }
+  const char* valueEnd = end;
+  while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+  {
+    --valueEnd;
+  }
+  int i = view_.numHeaders_++;
+  view_.fields_[i] = HttpRequestView::token(base, begin, colon);
+  view_.values_[i] = HttpRequestView::token(base, value, valueEnd);
+  return true;
+}
+
 // return false if any error
 /// 解析http请求
 /*
@@ -62,27 +147,34 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
 {
   bool ok = true;
   bool hasMore = true;
+  if (!headersCopied_)
+  {
+    view_.base_ = buf->peek();  // 上次解析之后Buffer可能搬移过数据, 偏移不变
+  }
   /// 一行一行解析
-  /// state_ = muduo::net::HttpContext::kExpectRequestLine
   while (hasMore)
   {
-    /// 解析请求行
+    /// 解析请求行和请求头, 只记录偏移, 不从buf中取走
     if (state_ == kExpectRequestLine)
     {
-      /// 找CR LR \r\n, 也就是请求行结束的位置
-      const char* crlf = buf->findCRLF();
-      if (crlf)
+      // buf中存储的字符如"GET / HTTP/1.1\r\nHost: 127.0.0.1:8000\r\nUser-Agent: curl/7.61.0\r\nAccept:
+      const char* base = buf->peek();
+      const char* begin = base + parsed_;
+      /// 找CR LR \r\n, 也就是这一行结束的位置
+      const char* crlf = buf->findCRLF(begin);
+      if (!crlf)
+      {
+        ok = buf->readableBytes() <= kMaxHeaderBytes;
+        hasMore = false;
+      }
+      else
       {
-        /// 从buf中找到crlf
-        // buf中存储的字符如"GET / HTTP/1.1\r\nHost: 127.0.0.1:8000\r\nUser-Agent: curl/7.61.0\r\nAccept: 
         /// 可以解析出method, httpversion
-        ok = processRequestLine(buf->peek(), crlf); 
+        ok = processRequestLine(base, begin, crlf);
         if (ok)
         {
-          request_.setReceiveTime(receiveTime);
-          /// 读后更新buffer索引, 也就是更新buf->peek()可读位置
-          buf->retrieveUntil(crlf + 2);
-          /// kExpectHeaders
+          view_.receiveTime_ = receiveTime;
+          parsed_ = static_cast<size_t>(crlf + 2 - base);
           state_ = kExpectHeaders;
         }
         else
@@ -90,51 +182,232 @@ bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
           hasMore = false;
         }
       }
+    }
+    else if (state_ == kExpectHeaders)
+    {
+      const char* base = buf->peek();
+      const char* begin = base + parsed_;
+      const char* colon = NULL;
+      const char* crlf = NULL;
+      /// 找冒号和行尾, 同时校验字符
+      HttpTokenizer::Result result = HttpTokenizer::scanHeaderLine(begin, buf->beginWrite(), &colon, &crlf);
+      if (result == HttpTokenizer::kIncomplete)
+      {
+        ok = buf->readableBytes() <= kMaxHeaderBytes;
+        hasMore = false;
+      }
+      else if (result == HttpTokenizer::kInvalid)
+      {
+        ok = false;
+        hasMore = false;
+      }
+      else if (colon != NULL)
+      {
+        parsed_ = static_cast<size_t>(crlf + 2 - base);
+        ok = processHeader(base, begin, colon, crlf) && parsed_ <= kMaxHeaderBytes;
+        hasMore = ok;
+      }
       else
       {
+        /// 这一行说明该到Body了
+        // empty line, end of header
+        parsed_ = static_cast<size_t>(crlf + 2 - base);
+        ok = processHeadersEnd(buf);
+        hasMore = ok && state_ != kGotAll;
+      }
+    }
+    else if (state_ == kExpectBody && !headersCopied_)
+    {
+      /// body和头部一起留在buf中, 到齐了才算完整
+      if (buf->readableBytes() - parsed_ >= bodyRemaining_)
+      {
+        view_.body_ = StringPiece(buf->peek() + parsed_, static_cast<int>(bodyRemaining_));
+        parsed_ += bodyRemaining_;
+        bodyRemaining_ = 0;
+        finish(buf);
+      }
+      hasMore = false;
+    }
+    else if (state_ == kExpectBody || state_ == kExpectChunkData)
+    {
+      /// body可能分多次到达, 到了多少交出多少, 并从buf中取走
+      size_t n = std::min(buf->readableBytes(), bodyRemaining_);
+      if (n > 0)
+      {
+        receiveBody(buf->peek(), n);
+        buf->retrieve(n);
+        bodyRemaining_ -= n;
+      }
+      if (bodyRemaining_ > 0)
+      {
+        hasMore = false;  // 等后续数据
+      }
+      else if (state_ == kExpectBody)
+      {
+        finish(buf); /// 已经读完
         hasMore = false;
       }
+      else
+      {
+        state_ = kExpectChunkDataCRLF;
+      }
     }
-    /// 该解析请求头了
-    else if (state_ == kExpectHeaders)  // 解析请求头
+    else if (state_ == kExpectChunkSize)
     {
-      /// 请求头结束的地方
       const char* crlf = buf->findCRLF();
       if (crlf)
       {
-        /// 在buf->peek()到crlf寻找:, peek是可读buf地址
-        const char* colon = std::find(buf->peek(), crlf, ':');  
-        if (colon != crlf)  // 如果可以找到
+        ok = parseChunkSize(buf->peek(), crlf, &bodyRemaining_)
+            && static_cast<size_t>(crlf - buf->peek()) <= kMaxChunkSizeLine;
+        if (ok && !bodyCallback_ && bodyScratch_.size() + bodyRemaining_ > maxBodySize_)
         {
-          request_.addHeader(buf->peek(), colon, crlf);
+          bodyTooLarge_ = true;  // 解码后的body放在bodyScratch_中, 在收到数据之前拒绝
+          ok = false;
+        }
+        if (ok)
+        {
+          buf->retrieveUntil(crlf + 2);
+          state_ = bodyRemaining_ > 0 ? kExpectChunkData : kExpectTrailers;  // 大小为0的chunk是结尾
         }
         else
         {
-          /// 这一行说明该到Body了
-          // empty line, end of header
-          state_ = kExpectBody;
-          
+          hasMore = false;
         }
-        /// crlf + 位置已经读完
-        buf->retrieveUntil(crlf + 2); /// 跳过\r\n
       }
       else
       {
+        ok = buf->readableBytes() <= kMaxChunkSizeLine + 1;  // 可能只差'\n'
         hasMore = false;
       }
     }
+    else if (state_ == kExpectChunkDataCRLF)  // chunk数据后面的\r\n
+    {
+      if (buf->readableBytes() < 2)
+      {
+        hasMore = false;
+      }
+      else if (buf->peek()[0] == '\r' && buf->peek()[1] == '\n')
+      {
+        buf->retrieve(2);
+        state_ = kExpectChunkSize;
+      }
+      else
+      {
+        ok = false;
+        hasMore = false;
+      }
+    }
+    else if (state_ == kExpectTrailers)  // trailer字段忽略, 直到空行
+    {
+      const char* crlf = buf->findCRLF();
+      if (crlf)
+      {
+        bool emptyLine = crlf == buf->peek();
+        trailerBytes_ += static_cast<size_t>(crlf + 2 - buf->peek());
+        buf->retrieveUntil(crlf + 2);
+        if (emptyLine)
+        {
+          finish(buf);
+          hasMore = false;
+        }
+        else if (trailerBytes_ > kMaxHeaderBytes)
+        {
+          ok = false;
+          hasMore = false;
+        }
+      }
+      else
+      {
+        ok = trailerBytes_ + buf->readableBytes() <= kMaxHeaderBytes;
+        hasMore = false;
+      }
+    }
+    else
+    {
+      hasMore = false;  // kGotAll, 等reset()
+    }
+  }
+  return ok;
+}
 
-    else if (state_ == kExpectBody)
+bool HttpContext::processHeadersEnd(Buffer* buf)
+{
+  StringPiece transferEncoding = view_.getHeader("Transfer-Encoding");
+  StringPiece contentLength = view_.getHeader("Content-Length");
+  if (!transferEncoding.empty())
+  {
+    // 两个都有时以Transfer-Encoding为准(RFC 7230 3.3.3); 请求只支持chunked
+    if (transferEncoding.size() != 7 || ::strncasecmp(transferEncoding.data(), "chunked", 7) != 0)
+    {
+      return false;
+    }
+    copyHeaders(buf);  // chunk的分隔要从body中去掉, body不能留在buf中原地引用
+    state_ = kExpectChunkSize;
+  }
+  else if (!contentLength.empty())
+  {
+    if (!parseContentLength(contentLength, &bodyRemaining_))
+    {
+      return false;
+    }
+    if (bodyRemaining_ == 0)
     {
-      /// 这个直接让用户解析, 把Body给用户
-      //if (buf->peek() != buf->beginWrite())
+      finish(buf);
+    }
+    else if (bodyCallback_)
+    {
+      copyHeaders(buf);  // body边到达边交给回调并取走
+      state_ = kExpectBody;
+    }
+    else
+    {
+      if (bodyRemaining_ > maxBodySize_ || bodyRemaining_ > static_cast<size_t>(INT_MAX))
+      {
+        bodyTooLarge_ = true;  // body要整个留在输入Buffer中, 还没收到就拒绝
+        return false;
+      }
+      state_ = kExpectBody;
+    }
+  }
+  else
+  {
+    // 都没有的请求没有body, buffer里剩下的字节是流水线中的下一个请求
+    finish(buf);
+  }
+  return true;
+}
 
-      if (buf->readableBytes() > 0 ) /// 还没有读完
-        request_.setBody(buf->peek(), buf->beginWrite());
+void HttpContext::copyHeaders(Buffer* buf)
+{
+  headerScratch_.assign(buf->peek(), parsed_);  // 容量在请求之间复用
+  buf->retrieve(parsed_);
+  parsed_ = 0;
+  view_.base_ = headerScratch_.data();
+  headersCopied_ = true;
+}
 
-      state_ = kGotAll; /// 已经读完
-      hasMore = false;
-    }
+void HttpContext::receiveBody(const char* data, size_t len)
+{
+  if (bodyCallback_)
+  {
+    bodyCallback_(view_, data, len);
   }
-  return ok;
+  else
+  {
+    bodyScratch_.append(data, len);
+  }
+}
+
+void HttpContext::finish(Buffer* buf)
+{
+  if (!headersCopied_)
+  {
+    buf->retrieve(parsed_);  // 只是移动读索引, 数据留在原处, 下次读入之前view_一直有效
+    parsed_ = 0;
+  }
+  else if (!bodyCallback_)
+  {
+    view_.body_ = StringPiece(bodyScratch_);
+  }
+  state_ = kGotAll;
 }
@@ -1,9 +1,12 @@
 #ifndef MUDUO_NET_HTTP_HTTPCONTEXT_H_
 #define MUDUO_NET_HTTP_HTTPCONTEXT_H_
 
+#include <functional>
+
 #include "muduo/include/base/copyable.h"
 
 #include "http/HttpRequest.h"
+#include "http/HttpRequestView.h"
 
 namespace muduo
 {
@@ -12,6 +15,12 @@ namespace net
 
 class Buffer;
 
+///
+/// 请求解析器, 每个连接一个。
+/// 请求行和头部解析完之前不从Buffer中取走数据, 只记录各字段相对请求起点的偏移,
+/// 请求完整后一次取走, requestView()直接指向Buffer中的数据(取走不会覆盖, 直到下次读入)。
+/// chunked编码或者设置了body回调的请求在头部结束时把头部复制出来, 之后body边到达边消费。
+///
 class HttpContext : public muduo::copyable
 {
  public:
@@ -20,16 +29,49 @@ class HttpContext : public muduo::copyable
   {
     kExpectRequestLine,
     kExpectHeaders,
-    kExpectBody,
+    kExpectBody,  // Content-Length的body
+    kExpectChunkSize,  // Transfer-Encoding: chunked, 下面几个状态依次解析每个chunk
+    kExpectChunkData,
+    kExpectChunkDataCRLF,
+    kExpectTrailers,
     kGotAll,
   };
 
+  static const size_t kMaxHeaderBytes = 64 * 1024;  // 请求行加头部的上限, trailer部分也是, 超过时解析失败
+  static const size_t kMaxChunkSizeLine = 1024;  // chunk-size行(包括扩展)的上限
+  static const size_t kDefaultMaxBodySize = 8 * 1024 * 1024;
+
+  /// body的一个片段, 到达多少交出多少
+  typedef std::function<void (const HttpRequestView&, const char* data, size_t len)> BodyCallback;
+
   /// 设置初始化状态为kExpectRequestLine
   HttpContext()
-    : state_(kExpectRequestLine)
+    : state_(kExpectRequestLine),
+      parsed_(0),
+      bodyRemaining_(0),
+      maxBodySize_(kDefaultMaxBodySize),
+      trailerBytes_(0),
+      bodyTooLarge_(false),
+      headersCopied_(false),
+      requestBuilt_(false)
   {
   }
 
+  /// 放进内存的body(Content-Length或解码后的chunked)的上限, 超过时解析失败, bodyTooLarge()为true。
+  /// 设置了body回调时body不在内存中累积, 不受这个限制
+  void setMaxBodySize(size_t bytes)
+  { maxBodySize_ = bytes; }
+
+  /// 上一次parseRequest()失败是因为body超过了setMaxBodySize(), 应该回复413
+  bool bodyTooLarge() const
+  { return bodyTooLarge_; }
+
+  /// 设置后body按到达的片段交给cb, 不再放入请求的body
+  void setBodyCallback(const BodyCallback& cb)
+  { bodyCallback_ = cb; }
+
+  /// 增量解析, 每次消费buf中能解析的部分, 包括按Content-Length或chunked编码读到的body;
+  /// 一个请求结束后停下, buf中剩下的是下一个请求
   bool parseRequest(Buffer* buf, Timestamp receiveTime);
 
   bool gotAll() const
@@ -38,21 +80,58 @@ class HttpContext : public muduo::copyable
   void reset()
   {
     state_ = kExpectRequestLine;
-    HttpRequest dummy;
-    request_.swap(dummy);
+    parsed_ = 0;
+    bodyRemaining_ = 0;
+    trailerBytes_ = 0;
+    bodyTooLarge_ = false;
+    headersCopied_ = false;
+    requestBuilt_ = false;
+    view_.clear();
+    bodyScratch_.clear();  // 保留容量, 下一个请求复用
   }
 
+  /// 零拷贝的请求, gotAll()之后到下一次向Buffer读入数据之前有效
+  const HttpRequestView& requestView() const
+  { return view_; }
+
+  /// 拥有数据的请求, 第一次调用时从requestView()复制
   const HttpRequest& request() const
-  { return request_; }
+  {
+    if (!requestBuilt_)
+    {
+      request_ = view_.materialize();
+      requestBuilt_ = true;
+    }
+    return request_;
+  }
 
   HttpRequest& request()
-  { return request_; }
+  {
+    static_cast<const HttpContext*>(this)->request();
+    return request_;
+  }
 
  private:
-  bool processRequestLine(const char* begin, const char* end);
+  bool processRequestLine(const char* base, const char* begin, const char* end);
+  bool processHeader(const char* base, const char* begin, const char* colon, const char* end);
+  bool processHeadersEnd(Buffer* buf);  // 根据Transfer-Encoding和Content-Length决定怎样读body
+  void copyHeaders(Buffer* buf);
+  void receiveBody(const char* data, size_t len);
+  void finish(Buffer* buf);
 
   HttpRequestParseState state_; // 解析状态
-  HttpRequest request_; // 封装的HttpRequest
+  HttpRequestView view_;
+  size_t parsed_;  // 头部还在Buffer中时, 当前请求已经解析过的字节数
+  size_t bodyRemaining_;  // Content-Length的body或者当前chunk还差多少字节
+  size_t maxBodySize_;
+  size_t trailerBytes_;  // 已经读过的trailer字节数
+  bool bodyTooLarge_;
+  bool headersCopied_;  // 头部已经复制到headerScratch_, 从Buffer中取走了
+  string headerScratch_;
+  string bodyScratch_;  // 解码后的chunked body
+  BodyCallback bodyCallback_;
+  mutable HttpRequest request_; // 封装的HttpRequest
+  mutable bool requestBuilt_;
 };
 
 }  // namespace net
@@ -6,6 +6,7 @@
 #include <stdio.h>
 
 #include "muduo/include/base/copyable.h"
+#include "muduo/include/base/StringPiece.h"
 #include "muduo/include/base/Timestamp.h"
 #include "muduo/include/base/Types.h"
 
@@ -44,41 +45,47 @@ class HttpRequest : public muduo::copyable
   bool setMethod(const char* start, const char* end)
   {
     assert(method_ == kInvalid);
-    string m(start, end);
+    method_ = parseMethod(start, end);
+    return method_ != kInvalid;
+  }
+
+  /// 不认识的方法返回kInvalid, 不构造临时string
+  static Method parseMethod(const char* start, const char* end)
+  {
+    StringPiece m(start, static_cast<int>(end - start));
     if (m == "GET")
     {
-      method_ = kGet;
+      return kGet;
     }
     else if (m == "POST")
     {
-      method_ = kPost;
+      return kPost;
     }
     else if (m == "HEAD")
     {
-      method_ = kHead;
+      return kHead;
     }
     else if (m == "PUT")
     {
-      method_ = kPut;
+      return kPut;
     }
     else if (m == "DELETE")
     {
-      method_ = kDelete;
-    }
-    else
-    {
-      method_ = kInvalid;
+      return kDelete;
     }
-    return method_ != kInvalid;
+    return kInvalid;
   }
 
   Method method() const
   { return method_; }
 
   const char* methodString() const
+  { return methodString(method_); }
+
+  static const char* methodString(Method method)
   {
     const char* result = "UNKNOWN";
-    switch(method_)
+    switch(method)
     {
       case kGet:
         result = "GET";
@@ -144,6 +151,12 @@ class HttpRequest : public muduo::copyable
     headers_[field] = value;
   }
 
+  /// value已经去掉首尾空白
+  void addHeader(StringPiece field, StringPiece value)
+  {
+    headers_[field.as_string()] = value.as_string();
+  }
+
   string getHeader(const string& field) const
   {
     string result;
@@ -167,6 +180,7 @@ class HttpRequest : public muduo::copyable
     query_.swap(that.query_);
     receiveTime_.swap(that.receiveTime_);
     headers_.swap(that.headers_);
+    body_.swap(that.body_);
   }
 
   string body_; /// http请求 body的内容, 用户自己解析吧
@@ -0,0 +1,159 @@
+#ifndef MUDUO_NET_HTTP_HTTPREQUESTVIEW_H_
+#define MUDUO_NET_HTTP_HTTPREQUESTVIEW_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "muduo/include/base/copyable.h"
+#include "muduo/include/base/StringPiece.h"
+#include "muduo/include/base/Timestamp.h"
+
+#include "http/HttpRequest.h"
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// 不拥有数据的请求: 各字段都是指向连接输入Buffer的StringPiece, 头部是定长的内联数组,
+/// 解析一个请求不分配内存。
+/// 只在HttpCallback执行期间有效(之后Buffer会继续读入数据); 要在回调之外使用时用materialize()复制一份。
+///
+class HttpRequestView : public muduo::copyable
+{
+ public:
+  static const int kMaxHeaders = 64;  // 超过时解析失败
+
+  struct Header
+  {
+    StringPiece field;
+    StringPiece value;  // 已去掉首尾空白
+  };
+
+  HttpRequestView()
+    : base_(NULL),
+      method_(HttpRequest::kInvalid),
+      version_(HttpRequest::kUnknown),
+      path_(),
+      query_(),
+      numHeaders_(0)
+  {
+  }
+
+  HttpRequest::Method method() const
+  { return method_; }
+
+  const char* methodString() const
+  { return HttpRequest::methodString(method_); }
+
+  HttpRequest::Version getVersion() const
+  { return version_; }
+
+  StringPiece path() const
+  { return piece(path_); }
+
+  /// 和HttpRequest::query()一样包含开头的'?'
+  StringPiece query() const
+  { return piece(query_); }
+
+  Timestamp receiveTime() const
+  { return receiveTime_; }
+
+  /// 设置了body回调时为空
+  StringPiece body() const
+  { return body_; }
+
+  int headerCount() const
+  { return numHeaders_; }
+
+  Header header(int i) const
+  {
+    Header h = { piece(fields_[i]), piece(values_[i]) };
+    return h;
+  }
+
+  /// 字段名不区分大小写, 没有时返回空
+  StringPiece getHeader(StringPiece field) const
+  {
+    for (int i = 0; i < numHeaders_; ++i)
+    {
+      if (fields_[i].length == static_cast<uint32_t>(field.size())
+          && ::strncasecmp(base_ + fields_[i].offset, field.data(), field.size()) == 0)
+      {
+        return piece(values_[i]);
+      }
+    }
+    return StringPiece();
+  }
+
+  /// 复制成拥有数据的HttpRequest, 可以在回调之外保存
+  HttpRequest materialize() const
+  {
+    HttpRequest request;
+    if (method_ != HttpRequest::kInvalid)
+    {
+      const char* method = methodString();
+      request.setMethod(method, method + strlen(method));
+    }
+    request.setVersion(version_);
+    StringPiece p = path();
+    request.setPath(p.begin(), p.end());
+    StringPiece q = query();
+    request.setQuery(q.begin(), q.end());
+    request.setReceiveTime(receiveTime_);
+    for (int i = 0; i < numHeaders_; ++i)
+    {
+      request.addHeader(piece(fields_[i]), piece(values_[i]));
+    }
+    request.setBody(body_.begin(), body_.end());
+    return request;
+  }
+
+ private:
+  friend class HttpContext;
+
+  /// 相对base_的偏移, 解析过程中Buffer可能搬移数据, 偏移不变
+  struct Token
+  {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  StringPiece piece(Token t) const
+  { return t.length > 0 ? StringPiece(base_ + t.offset, static_cast<int>(t.length)) : StringPiece(); }
+
+  static Token token(const char* base, const char* begin, const char* end)
+  {
+    Token t = { static_cast<uint32_t>(begin - base), static_cast<uint32_t>(end - begin) };
+    return t;
+  }
+
+  void clear()
+  {
+    base_ = NULL;
+    body_.clear();
+    method_ = HttpRequest::kInvalid;
+    version_ = HttpRequest::kUnknown;
+    path_ = Token();
+    query_ = Token();
+    numHeaders_ = 0;
+  }
+
+  const char* base_;  // 请求行和头部的起点
+  StringPiece body_;
+  HttpRequest::Method method_;
+  HttpRequest::Version version_;
+  Timestamp receiveTime_;
+  Token path_;
+  Token query_;
+  int numHeaders_;
+  Token fields_[kMaxHeaders];
+  Token values_[kMaxHeaders];
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPREQUESTVIEW_H_
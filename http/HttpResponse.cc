@@ -1,41 +1,347 @@
 #include "http/HttpResponse.h"
 #include "muduo/include/net/Buffer.h"
+#include "muduo/include/net/EventLoop.h"
 
+#include <algorithm>
+
+#include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+struct StatusReason
+{
+  int code;
+  const char* reason;
+};
+
+// IANA登记的状态码
+const StatusReason kReasons[] =
+{
+  { 100, "Continue" },
+  { 101, "Switching Protocols" },
+  { 102, "Processing" },
+  { 103, "Early Hints" },
+  { 200, "OK" },
+  { 201, "Created" },
+  { 202, "Accepted" },
+  { 203, "Non-Authoritative Information" },
+  { 204, "No Content" },
+  { 205, "Reset Content" },
+  { 206, "Partial Content" },
+  { 207, "Multi-Status" },
+  { 208, "Already Reported" },
+  { 226, "IM Used" },
+  { 300, "Multiple Choices" },
+  { 301, "Moved Permanently" },
+  { 302, "Found" },
+  { 303, "See Other" },
+  { 304, "Not Modified" },
+  { 305, "Use Proxy" },
+  { 307, "Temporary Redirect" },
+  { 308, "Permanent Redirect" },
+  { 400, "Bad Request" },
+  { 401, "Unauthorized" },
+  { 402, "Payment Required" },
+  { 403, "Forbidden" },
+  { 404, "Not Found" },
+  { 405, "Method Not Allowed" },
+  { 406, "Not Acceptable" },
+  { 407, "Proxy Authentication Required" },
+  { 408, "Request Timeout" },
+  { 409, "Conflict" },
+  { 410, "Gone" },
+  { 411, "Length Required" },
+  { 412, "Precondition Failed" },
+  { 413, "Content Too Large" },
+  { 414, "URI Too Long" },
+  { 415, "Unsupported Media Type" },
+  { 416, "Range Not Satisfiable" },
+  { 417, "Expectation Failed" },
+  { 421, "Misdirected Request" },
+  { 422, "Unprocessable Content" },
+  { 423, "Locked" },
+  { 424, "Failed Dependency" },
+  { 425, "Too Early" },
+  { 426, "Upgrade Required" },
+  { 428, "Precondition Required" },
+  { 429, "Too Many Requests" },
+  { 431, "Request Header Fields Too Large" },
+  { 451, "Unavailable For Legal Reasons" },
+  { 500, "Internal Server Error" },
+  { 501, "Not Implemented" },
+  { 502, "Bad Gateway" },
+  { 503, "Service Unavailable" },
+  { 504, "Gateway Timeout" },
+  { 505, "HTTP Version Not Supported" },
+  { 506, "Variant Also Negotiates" },
+  { 507, "Insufficient Storage" },
+  { 508, "Loop Detected" },
+  { 510, "Not Extended" },
+  { 511, "Network Authentication Required" },
+};
+
+/// 100~599每个状态码的"HTTP/1.1 200 OK\r\n", 没有登记的状态码只有数字和空短语
+class StatusLines
+{
+ public:
+  static const int kMin = 100;
+  static const int kMax = 599;
+
+  StatusLines()
+  {
+    for (int code = kMin; code <= kMax; ++code)
+    {
+      const char* reason = "";
+      for (const StatusReason& item : kReasons)
+      {
+        if (item.code == code)
+        {
+          reason = item.reason;
+          break;
+        }
+      }
+      Line& line = lines_[code - kMin];
+      line.length = static_cast<size_t>(snprintf(line.data, sizeof line.data, "HTTP/1.1 %d %s\r\n", code, reason));
+    }
+  }
+
+  /// 超出范围时返回空
+  StringPiece line(int code) const
+  {
+    if (code < kMin || code > kMax)
+    {
+      return StringPiece();
+    }
+    const Line& line = lines_[code - kMin];
+    return StringPiece(line.data, static_cast<int>(line.length));
+  }
+
+  static StringPiece reason(StringPiece line)
+  {
+    // 去掉"HTTP/1.1 200 "和"\r\n"
+    return StringPiece(line.data() + 13, line.size() - 15);
+  }
+
+ private:
+  struct Line
+  {
+    char data[48];
+    size_t length;
+  };
+
+  Line lines_[kMax - kMin + 1];
+};
+
+const StatusLines kStatusLines;
+
+/// 十进制, 返回长度
+size_t formatSize(char buf[], size_t value)
+{
+  char* p = buf;
+  do
+  {
+    *p++ = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  std::reverse(buf, p);
+  return static_cast<size_t>(p - buf);
+}
+
+const char* kWeekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+const char* kMonths[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                          "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+// 每个IO线程一个loop, 按线程缓存就是按loop缓存, 和Logger缓存日志时间的方式一样
+__thread char t_dateLine[64];
+__thread size_t t_dateLength;
+__thread int64_t t_dateSecond;
+
+/// "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n", 时间取loop本轮poll返回的时间, 秒数变化时才重新格式化
+StringPiece dateLine()
+{
+  int64_t seconds = EventLoop::cachedNow().secondsSinceEpoch();
+  if (seconds != t_dateSecond || t_dateLength == 0)
+  {
+    t_dateSecond = seconds;
+    time_t time = static_cast<time_t>(seconds);
+    struct tm tm_time;
+    ::gmtime_r(&time, &tm_time);
+    t_dateLength = static_cast<size_t>(snprintf(t_dateLine, sizeof t_dateLine,
+        "Date: %s, %02d %s %4d %02d:%02d:%02d GMT\r\n",
+        kWeekdays[tm_time.tm_wday], tm_time.tm_mday, kMonths[tm_time.tm_mon],
+        tm_time.tm_year + 1900, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec));
+  }
+  return StringPiece(t_dateLine, static_cast<int>(t_dateLength));
+}
+
+}  // namespace
+
+const size_t HttpResponse::kInlineHeaderBytes;
+
+bool HttpResponse::findHeader(StringPiece key, size_t* offset, size_t* length) const
+{
+  const char* data = headerData();
+  const size_t keyLength = static_cast<size_t>(key.size());
+  size_t start = 0;
+  while (start < headerLength_)
+  {
+    const char* line = data + start;
+    const char* lineEnd = static_cast<const char*>(memchr(line, '\n', headerLength_ - start)) + 1;
+    if (static_cast<size_t>(lineEnd - line) > keyLength + 1
+        && line[keyLength] == ':'
+        && memcmp(line, key.data(), keyLength) == 0)
+    {
+      *offset = start;
+      *length = static_cast<size_t>(lineEnd - line);
+      return true;
+    }
+    start += static_cast<size_t>(lineEnd - line);
+  }
+  return false;
+}
+
+void HttpResponse::addHeader(StringPiece key, StringPiece value)
+{
+  size_t offset = 0;
+  size_t length = 0;
+  if (findHeader(key, &offset, &length))
+  {
+    if (spilledHeaders_.empty())
+    {
+      memmove(inlineHeaders_ + offset, inlineHeaders_ + offset + length, headerLength_ - offset - length);
+    }
+    else
+    {
+      spilledHeaders_.erase(offset, length);
+    }
+    headerLength_ -= length;
+  }
+
+  const size_t lineLength = static_cast<size_t>(key.size() + value.size()) + 4;
+  if (spilledHeaders_.empty() && headerLength_ + lineLength > kInlineHeaderBytes)
+  {
+    spilledHeaders_.assign(inlineHeaders_, headerLength_);
+  }
+  if (spilledHeaders_.empty())
+  {
+    char* p = inlineHeaders_ + headerLength_;
+    memcpy(p, key.data(), static_cast<size_t>(key.size()));
+    p += key.size();
+    *p++ = ':';
+    *p++ = ' ';
+    memcpy(p, value.data(), static_cast<size_t>(value.size()));
+    p += value.size();
+    *p++ = '\r';
+    *p++ = '\n';
+  }
+  else
+  {
+    spilledHeaders_.append(key.data(), static_cast<size_t>(key.size()));
+    spilledHeaders_.append(": ");
+    spilledHeaders_.append(value.data(), static_cast<size_t>(value.size()));
+    spilledHeaders_.append("\r\n");
+  }
+  headerLength_ += lineLength;
+}
+
+StringPiece HttpResponse::getHeader(StringPiece key) const
+{
+  size_t offset = 0;
+  size_t length = 0;
+  if (!findHeader(key, &offset, &length))
+  {
+    return StringPiece();
+  }
+  const size_t skip = static_cast<size_t>(key.size()) + 2;  // "Key: "
+  return StringPiece(headerData() + offset + skip, static_cast<int>(length - skip - 2));
+}
+
 /// 将要回复的状态码等信息放置到output buffer中, 也就是Reponse对象序列化到Buffer中
+/// 各部分都是现成的字节, 一次预留空间后依次拷贝
 void HttpResponse::appendToBuffer(Buffer* output) const
 {
-  char buf[32];
-  snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
-  output->append(buf);
-  output->append(statusMessage_);
-  output->append("\r\n");
+  StringPiece statusLine = kStatusLines.line(statusCode_);
+  bool customStatus = statusLine.empty()
+      || (!statusMessage_.empty() && StatusLines::reason(statusLine) != statusMessage_);
+  char code[16];
+  size_t codeLength = formatSize(code, static_cast<size_t>(statusCode_));
+
+  StringPiece date;
+  size_t dateOffset = 0;
+  size_t dateLength = 0;
+  if (!findHeader("Date", &dateOffset, &dateLength))  // 用户设置了Date时不再添加
+  {
+    date = dateLine();
+  }
+
+  char contentLength[32];
+  size_t contentLengthLength = 0;
+  if (!closeConnection_)
+  {
+    memcpy(contentLength, "Content-Length: ", 16);
+    contentLengthLength = 16 + formatSize(contentLength + 16, bodyFile_ ? bodyFileSize_ : body_.size());
+    contentLength[contentLengthLength++] = '\r';
+    contentLength[contentLengthLength++] = '\n';
+  }
+
+  const size_t bodyLength = bodyFile_ ? 0 : body_.size();
+  output->ensureWritableBytes((customStatus ? 9 + codeLength + 1 + statusMessage_.size() + 2 : statusLine.size())
+                              + date.size() + contentLengthLength + 24 + headerLength_ + 2 + bodyLength);
+
+  if (customStatus)
+  {
+    output->append("HTTP/1.1 ", 9);
+    output->append(code, codeLength);
+    output->append(" ", 1);
+    output->append(statusMessage_);
+    output->append("\r\n", 2);
+  }
+  else
+  {
+    output->append(statusLine.data(), statusLine.size());
+  }
+  output->append(date.data(), date.size());
 
   if (closeConnection_)
   {
-    output->append("Connection: close\r\n");
+    output->append("Connection: close\r\n", 19);
   }
   else
   {
-    snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
-    output->append(buf);
-    output->append("Connection: Keep-Alive\r\n");
+    output->append(contentLength, contentLengthLength);
+    output->append("Connection: Keep-Alive\r\n", 24);
   }
 
   /// 响应头部
-  for (const auto& header : headers_)
+  output->append(headerData(), headerLength_);
+
+  output->append("\r\n", 2);
+  /// 设置Body, body文件由HttpServer另外发送
+  output->append(body_.data(), bodyLength);
+}
+
+bool HttpResponse::setBodyFile(const string& path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
   {
-    output->append(header.first);
-    output->append(": ");
-    output->append(header.second);
-    output->append("\r\n");
+    return false;
   }
-
-  output->append("\r\n");
-  /// 设置Body
-  output->append(body_);
+  struct stat st;
+  if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+  {
+    ::close(fd);
+    return false;
+  }
+  bodyFile_.reset(new int(fd), [](const int* p) { ::close(*p); delete p; });
+  bodyFileSize_ = static_cast<size_t>(st.st_size);
+  return true;
 }
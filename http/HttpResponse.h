@@ -2,9 +2,10 @@
 #define MUDUO_NET_HTTP_HTTPRESPONSE_H_
 
 #include "muduo/include/base/copyable.h"
+#include "muduo/include/base/StringPiece.h"
 #include "muduo/include/base/Types.h"
 
-#include <map>
+#include <memory>
 
 namespace muduo
 {
@@ -12,30 +13,53 @@ namespace net
 {
 
 class Buffer;
+
+///
+/// 响应。头部按"Key: Value\r\n"的格式存放在对象内的定长数组中(放不下时才转到堆上),
+/// 状态行查预先生成的表, Date头部每个线程(即每个loop)每秒格式化一次,
+/// 序列化时直接拷贝进输出Buffer, 常见的响应不分配内存。
+///
 class HttpResponse : public muduo::copyable
 {
  public:
- /// http状态码
+ /// http状态码, 表中有IANA登记的所有状态码, 这里没有列出的也可以强制转换后使用
   enum HttpStatusCode
   {
     kUnknown,
+    k100Continue = 100,
     k200Ok = 200,
+    k201Created = 201,
+    k204NoContent = 204,
+    k206PartialContent = 206,
     k301MovedPermanently = 301,
+    k302Found = 302,
+    k304NotModified = 304,
     k400BadRequest = 400,
+    k401Unauthorized = 401,
+    k403Forbidden = 403,
     k404NotFound = 404,
+    k405MethodNotAllowed = 405,
+    k413PayloadTooLarge = 413,
+    k500InternalServerError = 500,
+    k503ServiceUnavailable = 503,
   };
 
+  static const size_t kInlineHeaderBytes = 512;
+
   explicit HttpResponse(bool close)
     : statusCode_(kUnknown),
-      closeConnection_(close)
+      closeConnection_(close),
+      bodyFileSize_(0),
+      headerLength_(0)
   {
   }
 
   void setStatusCode(HttpStatusCode code)
   { statusCode_ = code; }
 
-  void setStatusMessage(const string& message)
-  { statusMessage_ = message; }
+  /// 和状态码的标准短语相同时可以不设置, 序列化时使用预先生成的状态行
+  void setStatusMessage(StringPiece message)
+  { message.CopyToString(&statusMessage_); }
 
   void setCloseConnection(bool on)
   { closeConnection_ = on; }
@@ -44,26 +68,48 @@ class HttpResponse : public muduo::copyable
   { return closeConnection_; }
 
   //// contentType
-  void setContentType(const string& contentType)
+  void setContentType(StringPiece contentType)
   { addHeader("Content-Type", contentType); }
-  /// header
-  // FIXME: replace string with StringPiece
-  void addHeader(const string& key, const string& value)
-  { headers_[key] = value; }
+  /// header, 同名(区分大小写)的头部会被替换
+  void addHeader(StringPiece key, StringPiece value);
+
+  /// 没有时返回空
+  StringPiece getHeader(StringPiece key) const;
   /// body
   void setBody(const string& body)
   { body_ = body; }
 
+  /// body为整个文件, 由HttpServer调用TcpConnection::sendFile零拷贝发送, 不读入body_
+  /// 文件打不开返回false
+  bool setBodyFile(const string& path);
+
+  /// 没有设置body文件时返回-1
+  int bodyFileFd() const
+  { return bodyFile_ ? *bodyFile_ : -1; }
+
+  size_t bodyFileSize() const
+  { return bodyFileSize_; }
+
+  /// 序列化状态行和头部, 没有body文件时包括body_
   void appendToBuffer(Buffer* output) const;
 
   string body_;
  private:
-  std::map<string, string> headers_;
+  const char* headerData() const
+  { return spilledHeaders_.empty() ? inlineHeaders_ : spilledHeaders_.data(); }
+
+  /// 返回"Key: "所在行的起点和长度(包括\r\n)
+  bool findHeader(StringPiece key, size_t* offset, size_t* length) const;
+
   HttpStatusCode statusCode_;
   // FIXME: add http version
   string statusMessage_;
   bool closeConnection_;
-  
+  std::shared_ptr<const int> bodyFile_;  // 文件描述符, 最后一个副本析构时close
+  size_t bodyFileSize_;
+  size_t headerLength_;
+  char inlineHeaders_[kInlineHeaderBytes];  // 序列化好的头部行
+  string spilledHeaders_;  // 超过kInlineHeaderBytes后全部头部转到这里
 };
 
 }  // namespace net
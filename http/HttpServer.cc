@@ -26,6 +26,16 @@ void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
 }  // namespace net
 }  // namespace muduo
 
+namespace
+{
+
+// 每个loop线程一个, 攒一次读事件中所有请求的响应; 发送后留着存储给下一次用, 稳定后不再分配。
+// 为大响应扩张过的超过kMaxKeptOutput就缩回去
+thread_local Buffer t_output;
+const size_t kMaxKeptOutput = 64 * 1024;
+
+}  // namespace
+
 /// 构造函数
 /// 设置用户定义的回调函数, TcpServer也是参数
 HttpServer::HttpServer(EventLoop* loop,
@@ -33,7 +43,8 @@ HttpServer::HttpServer(EventLoop* loop,
                        const string& name,
                        TcpServer::Option option)
   : server_(loop, listenAddr, name, option),
-    httpCallback_(detail::defaultHttpCallback)
+    httpCallback_(detail::defaultHttpCallback),
+    maxBodySize_(HttpContext::kDefaultMaxBodySize)
 {
   // 设置tcpserver的回调函数
   server_.setConnectionCallback(
@@ -57,7 +68,10 @@ void HttpServer::onConnection(const TcpConnectionPtr& conn)
   if (conn->connected())
   {
     //// 向tcpconnection中set context
-    conn->setContext(HttpContext());
+    HttpContext context;
+    context.setBodyCallback(bodyCallback_);
+    context.setMaxBodySize(maxBodySize_);
+    conn->setContext(context);
   }
 }
 
@@ -68,52 +82,87 @@ void HttpServer::onMessage(const TcpConnectionPtr& conn,
   // 直接将conn->getMutableContext()转为HttpContext类型
   HttpContext* context = boost::any_cast<HttpContext>(conn->getMutableContext());
 
-  // 调用context->parseRequest解析存在Buffer里的请求, 不能解析执行400 bad request
-  // 将请求字符串的信息设置为request的属性
-  if (!context->parseRequest(buf, receiveTime))
+  // 客户端流水线(pipelining)发来的多个请求可能在同一次读中, 全部处理完, 不等下一次可读(可能永远不来)。
+  // 响应按请求顺序攒在output里, 最后一次发送
+  Buffer& output = t_output;
+  bool close = false;
+  while (!close)
   {
-    // 直接发送400
-    conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-    conn->shutdown();
+    // 调用context->parseRequest解析存在Buffer里的请求, 不能解析执行400 bad request
+    // 将请求字符串的信息设置为request的属性
+    if (!context->parseRequest(buf, receiveTime))
+    {
+      output.append(context->bodyTooLarge() ? "HTTP/1.1 413 Content Too Large\r\n\r\n"
+                                            : "HTTP/1.1 400 Bad Request\r\n\r\n");
+      close = true;
+    }
+    // 调用context->gotAll()解析完毕， 调用onRequest
+    else if (context->gotAll())
+    {
+      close = onRequest(conn, *context, &output);
+      context->reset();
+    }
+    else
+    {
+      break;  // 请求还不完整, 等后续数据
+    }
   }
 
-  // 调用context->gotAll()解析完毕， 调用onRequest
-  if (context->gotAll())
+  if (output.readableBytes() > 0)
   {
-    // 调用onRequest
-    onRequest(conn, context->request());
-    context->reset();
+    conn->send(&output);
+    output.retrieveAll();  // 连接已断开时send()不会取走数据
+  }
+  if (output.internalCapacity() > kMaxKeptOutput)
+  {
+    output.shrink(0);
+  }
+  if (close)
+  {
+    buf->retrieveAll();  // 要关闭的连接, 后面的请求不再处理
+    conn->shutdown();
   }
 }
 
-void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
+bool HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpContext& context, Buffer* output)
 {
   // 处理request
-  const string& connection = req.getHeader("Connection");
+  const HttpRequestView& req = context.requestView();
+  StringPiece connection = req.getHeader("Connection");
   bool close = connection == "close" ||
     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
 
   HttpResponse response(close);
 
   /// 执行用户自定义回调函数
-  httpCallback_(req, &response);
-  
-  Buffer buf;
+  if (httpViewCallback_)
+  {
+    httpViewCallback_(req, &response);
+  }
+  else
+  {
+    httpCallback_(context.request(), &response);  // 复制成拥有数据的HttpRequest
+  }
+
   /// 状态码, contentType, header, body等由用户设置
-  /// 将response对象序列化
-  response.appendToBuffer(&buf);
+  /// 将response对象序列化, 追加在前面请求的响应之后
+  response.appendToBuffer(output);
   /*response 格式
-  {<muduo::copyable> = {<No data fields>}, headers_ = std::map with 2 elements = {["Content-Type"] = "text/html",
-    ["Server"] = "Muduo"}, statusCode_ = muduo::net::HttpResponse::k200Ok, statusMessage_ = "OK",
-  closeConnection_ = false,
-  body_ = "<html><head><title>This is title</title></head><body><h1>Hello</h1>Now is 20210913 08:12:43.152553</body></html>"}
+  HTTP/1.1 200 OK\r\n
+  Date: Mon, 13 Sep 2021 08:12:43 GMT\r\n
+  Content-Length: 112\r\n
+  Connection: Keep-Alive\r\n
+  Content-Type: text/html\r\n
+  Server: Muduo\r\n
+  \r\n
+  <html><head><title>This is title</title></head><body><h1>Hello</h1>Now is 20210913 08:12:43.152553</body></html>
   */
-  /// 发送
-  conn->send(&buf);
-
-  if (response.closeConnection())
+  if (response.bodyFileFd() >= 0)
   {
-    conn->shutdown();
+    /// 文件body排在头部之后, 由内核直接发送; 先把攒下的响应发出去才能保持顺序
+    conn->send(output);
+    conn->sendFile(response.bodyFileFd(), 0, response.bodyFileSize());
   }
-}
 
+  return response.closeConnection();
+}
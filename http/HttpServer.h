@@ -8,7 +8,9 @@ namespace muduo
 namespace net
 {
 
+class HttpContext;
 class HttpRequest;
+class HttpRequestView;
 class HttpResponse;
 
 /// A simple embeddable HTTP server designed for report status of a program.
@@ -21,6 +23,13 @@ class HttpServer : noncopyable
  /// httpCallback, 设置回调函数用, 传入HttpRequest&, HttpResponse*。前者不可修改, 后者可修改
   typedef std::function<void (const HttpRequest&,
                               HttpResponse*)> HttpCallback;
+  /// 零拷贝的请求, 只在回调期间有效, 见setHttpViewCallback()
+  typedef std::function<void (const HttpRequestView&,
+                              HttpResponse*)> HttpViewCallback;
+  /// 请求body的一个片段, 见setBodyCallback()
+  typedef std::function<void (const HttpRequestView&,
+                              const char* data,
+                              size_t len)> BodyCallback;
 
   HttpServer(EventLoop* loop,
              const InetAddress& listenAddr,
@@ -35,11 +44,38 @@ class HttpServer : noncopyable
     httpCallback_ = cb;
   }
 
+  /// 设置后代替HttpCallback, 请求不复制成HttpRequest, 字段直接引用连接的输入缓冲区;
+  /// 回调返回后还要用的请求用HttpRequestView::materialize()复制
+  void setHttpViewCallback(const HttpViewCallback& cb)
+  {
+    httpViewCallback_ = cb;
+  }
+
+  /// 流式处理上传: 设置后请求body(Content-Length或chunked)按到达的片段交给cb, 不再放入请求的body,
+  /// body收完后照常调用HttpCallback。需要在start()之前调用
+  void setBodyCallback(const BodyCallback& cb)
+  {
+    bodyCallback_ = cb;
+  }
+
+  /// 放进内存的请求body的上限, 超过时回复413并关闭连接, 默认HttpContext::kDefaultMaxBodySize。
+  /// 设置了body回调时不受限制。需要在start()之前调用
+  void setMaxBodySize(size_t bytes)
+  {
+    maxBodySize_ = bytes;
+  }
+
   void setThreadNum(int numThreads)
   {
     server_.setThreadNum(numThreads);
   }
 
+  /// keep-alive连接空闲超过seconds秒后关闭, 见TcpServer::setIdleTimeout()。需要在start()之前调用
+  void setKeepAliveTimeout(double seconds)
+  {
+    server_.setIdleTimeout(seconds);
+  }
+
   void start();
 
  private:
@@ -48,10 +84,14 @@ class HttpServer : noncopyable
   void onMessage(const TcpConnectionPtr& conn,
                  Buffer* buf,
                  Timestamp receiveTime);
-  void onRequest(const TcpConnectionPtr&, const HttpRequest&);
+  /// 响应追加到output, 返回是否要关闭连接
+  bool onRequest(const TcpConnectionPtr&, const HttpContext&, Buffer* output);
 
   TcpServer server_;  // httpServer维护一个TcpServer对象
   HttpCallback httpCallback_;
+  HttpViewCallback httpViewCallback_;
+  BodyCallback bodyCallback_;
+  size_t maxBodySize_;
 };
 
 }  // namespace net
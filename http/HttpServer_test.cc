@@ -57,29 +57,6 @@ HttpResponse::HttpStatusCode readFileContent(const char* file, string& content)
     return HttpResponse::k200Ok;
 }
 
-/// 读取图片文件, 使用C语言read接口, 将字符写入content中
-HttpResponse::HttpStatusCode readImgContent(const char* imgPath, string& content) {
-
-  FILE* f = fopen(imgPath, "rb");  /// 读二进制文件
-  if (f) {
-    fseek(f, 0, SEEK_END);  /// FILE*指针指向最后
-    size_t size = ftell(f); /// 返回当前文件指针相对于文件首的移动字节数
-
-    char buf[size];
-    fseek(f, 0, SEEK_SET);  /// FILE*指针返回文件开始位置
-    memset(buf, 0, size);
-
-    size_t nRead = fread(buf, sizeof(char), size, f); /// 读取流f中数据到buf中
-    fclose(f);
-    content = string(buf, sizeof(buf));
-    return HttpResponse::k200Ok;
-  }
-
-  return HttpResponse::k404NotFound;
-  
-}
-
-
 // 实际的请求处理
 void onRequest(const HttpRequest& req, HttpResponse* resp)
 {
@@ -236,17 +213,17 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
       HttpResponse::HttpStatusCode status;
       if(strstr(resPath.c_str(), ".jpg") || strstr(resPath.c_str(), ".png"))
       {
-        /// 打开图片文件
-        status = readImgContent(resPath.data(), content);
+        /// 图片文件不再读入内存, 由sendfile直接发送
+        status = resp->setBodyFile(resPath) ? HttpResponse::k200Ok : HttpResponse::k404NotFound;
       }else
       {
         status = readFileContent(resPath.data(), content);
+        /// 设置buf的string为返回对象
+        resp->setBody(content);
       }
       resp->setStatusCode(status);
       resp->setStatusMessage("OK");
       resp->addHeader("Server", "Jackster");
-      /// 设置buf的string为返回对象
-      resp->setBody(content);
   }
   fileIsExist.close();
 }
@@ -0,0 +1,253 @@
+#include "http/HttpTokenizer.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+/// 值和请求目标的结束字符: 除HTAB外的控制字符、DEL和extra。
+/// 值传入'\0'(本来就是控制字符), 请求目标传入' '
+inline bool isStop(unsigned char c, char extra)
+{
+  return (c < 0x20 && c != '\t') || c == 0x7f || c == static_cast<unsigned char>(extra);
+}
+
+const char* findStopScalar(const char* begin, const char* end, char extra)
+{
+  for (const char* p = begin; p < end; ++p)
+  {
+    if (isStop(static_cast<unsigned char>(*p), extra))
+    {
+      return p;
+    }
+  }
+  return end;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+const char* findStopSse42(const char* begin, const char* end, char extra)
+{
+  // pcmpestri的范围模式, 每两个字节是一个闭区间
+  static const char kRanges[16] = "\x00\x08\x0a\x1f\x7f\x7f";
+  char ranges[16];
+  memcpy(ranges, kRanges, sizeof ranges);
+  ranges[6] = extra;
+  ranges[7] = extra;
+  const __m128i set = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranges));
+  const char* p = begin;
+  for (; end - p >= 16; p += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int i = _mm_cmpestri(set, 8, v, 16,
+                         _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+    if (i < 16)
+    {
+      return p + i;
+    }
+  }
+  return findStopScalar(p, end, extra);
+}
+
+__attribute__((target("avx2")))
+const char* findStopAvx2(const char* begin, const char* end, char extra)
+{
+  const __m256i ctlMax = _mm256_set1_epi8(0x1f);
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  const __m256i ext = _mm256_set1_epi8(extra);
+  const char* p = begin;
+  for (; end - p >= 32; p += 32)
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctlMax), v);  // 无符号 v <= 0x1f
+    ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), ctl);
+    __m256i stop = _mm256_or_si256(ctl, _mm256_or_si256(_mm256_cmpeq_epi8(v, del),
+                                                         _mm256_cmpeq_epi8(v, ext)));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(stop));
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(mask);
+    }
+  }
+  if (end - p >= 16)
+  {
+    // 尾部的16字节也用VEX编码的128位指令, 调用非VEX的SSE版本有状态切换的开销
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm256_castsi256_si128(ctlMax)), v);
+    ctl = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(tab)), ctl);
+    __m128i stop = _mm_or_si128(ctl, _mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(del)),
+                                                  _mm_cmpeq_epi8(v, _mm256_castsi256_si128(ext))));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(stop));
+    if (mask != 0)
+    {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+  return findStopScalar(p, end, extra);
+}
+
+#endif
+
+typedef const char* (*FindStopFunc)(const char*, const char*, char);
+
+struct Implementation
+{
+  const char* name;
+  FindStopFunc findStop;
+  bool (*supported)();
+};
+
+bool alwaysSupported()
+{
+  return true;
+}
+
+#if defined(__x86_64__)
+bool supportsSse42()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+bool supportsAvx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+#endif
+
+// 按优先级排列
+const Implementation kImplementations[] =
+{
+#if defined(__x86_64__)
+  { "avx2", findStopAvx2, supportsAvx2 },
+  { "sse4.2", findStopSse42, supportsSse42 },
+#endif
+  { "scalar", findStopScalar, alwaysSupported },
+};
+
+const Implementation* selectBest()
+{
+  for (const Implementation& impl : kImplementations)
+  {
+    if (impl.supported())
+    {
+      return &impl;
+    }
+  }
+  return NULL;
+}
+
+const Implementation* g_impl = selectBest();
+
+/// RFC 7230的tchar: 字段名和方法允许的字符
+struct TokenChars
+{
+  TokenChars()
+  {
+    for (int c = 0; c < 256; ++c)
+    {
+      table[c] = isalnum(c) != 0;
+    }
+    for (const char* p = "!#$%&'*+-.^_`|~"; *p; ++p)
+    {
+      table[static_cast<unsigned char>(*p)] = true;
+    }
+  }
+
+  bool table[256];
+};
+
+const TokenChars kTokenChars;
+
+}  // namespace
+
+HttpTokenizer::Result HttpTokenizer::scanHeaderLine(const char* begin, const char* end,
+                                                    const char** colon, const char** crlf)
+{
+  if (end - begin < 2)
+  {
+    return kIncomplete;
+  }
+  if (*begin == '\r')
+  {
+    *colon = NULL;
+    *crlf = begin;
+    return begin[1] == '\n' ? kOk : kInvalid;
+  }
+
+  // 字段名一般只有十几个字节, 查表比向量化划算, 找':'和校验在同一个循环
+  const char* p = begin;
+  while (p < end && kTokenChars.table[static_cast<unsigned char>(*p)])
+  {
+    ++p;
+  }
+  if (p == end)
+  {
+    return kIncomplete;
+  }
+  if (*p != ':' || p == begin)
+  {
+    return kInvalid;  // 包括字段名和冒号之间的空白, 以及以空白开头的折行
+  }
+  *colon = p;
+
+  const char* stop = g_impl->findStop(p + 1, end, '\0');
+  if (stop == end)
+  {
+    return kIncomplete;
+  }
+  if (*stop != '\r')
+  {
+    return kInvalid;
+  }
+  if (stop + 1 == end)
+  {
+    return kIncomplete;
+  }
+  if (stop[1] != '\n')
+  {
+    return kInvalid;
+  }
+  *crlf = stop;
+  return kOk;
+}
+
+const char* HttpTokenizer::scanTarget(const char* begin, const char* end)
+{
+  const char* stop = g_impl->findStop(begin, end, ' ');
+  return stop == end || *stop == ' ' ? stop : NULL;
+}
+
+const char* HttpTokenizer::implementation()
+{
+  return g_impl->name;
+}
+
+bool HttpTokenizer::setImplementation(const char* name)
+{
+  for (const Implementation& impl : kImplementations)
+  {
+    if (strcmp(impl.name, name) == 0)
+    {
+      if (!impl.supported())
+      {
+        return false;
+      }
+      g_impl = &impl;
+      return true;
+    }
+  }
+  return false;
+}
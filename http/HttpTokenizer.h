@@ -0,0 +1,46 @@
+#ifndef MUDUO_NET_HTTP_HTTPTOKENIZER_H_
+#define MUDUO_NET_HTTP_HTTPTOKENIZER_H_
+
+#include "muduo/include/base/noncopyable.h"
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// 请求行和头部的分词, HttpContext使用。
+/// 头部值和请求目标一次检查16/32字节(SSE4.2的pcmpestri或AVX2), 找分隔符的同时校验字符,
+/// 遇到控制字符就停下; 启动时按CPU选择实现, 不支持时用逐字节的版本。
+///
+class HttpTokenizer : noncopyable
+{
+ public:
+  enum Result
+  {
+    kOk,
+    kIncomplete,  // 没有完整的一行, 等后续数据
+    kInvalid,
+  };
+
+  /// 解析[begin, end)开头的一个头部行 field ":" value CRLF。
+  /// 字段名只能是token字符, 值不能有除HTAB以外的控制字符。
+  /// 空行时*colon为NULL, *crlf为begin
+  static Result scanHeaderLine(const char* begin, const char* end,
+                               const char** colon, const char** crlf);
+
+  /// 请求目标: 返回第一个空格, 遇到HTAB以外的控制字符返回NULL, 没有空格返回end
+  static const char* scanTarget(const char* begin, const char* end);
+
+  /// 当前使用的实现, "avx2", "sse4.2"或"scalar"
+  static const char* implementation();
+
+  /// 切换实现, CPU不支持或名字不对时返回false。
+  /// 供测试和benchmark使用, 不能和解析并发调用
+  static bool setImplementation(const char* name);
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_HTTP_HTTPTOKENIZER_H_
@@ -1,5 +1,7 @@
 #include "http/HttpContext.h"
-#include "muduo/net/Buffer.h"
+#include "http/HttpResponse.h"
+#include "http/HttpTokenizer.h"
+#include "muduo/include/net/Buffer.h"
 
 //#define BOOST_TEST_MODULE BufferTest
 #define BOOST_TEST_MAIN
@@ -7,10 +9,14 @@
 #include <boost/test/unit_test.hpp>
 
 using muduo::string;
+using muduo::StringPiece;
 using muduo::Timestamp;
 using muduo::net::Buffer;
 using muduo::net::HttpContext;
 using muduo::net::HttpRequest;
+using muduo::net::HttpRequestView;
+using muduo::net::HttpResponse;
+using muduo::net::HttpTokenizer;
 
 BOOST_AUTO_TEST_CASE(testParseRequestAllInOne)
 {
@@ -77,3 +83,395 @@ BOOST_AUTO_TEST_CASE(testParseRequestEmptyHeaderValue)
   BOOST_CHECK_EQUAL(request.getHeader("User-Agent"), string(""));
   BOOST_CHECK_EQUAL(request.getHeader("Accept-Encoding"), string(""));
 }
+
+BOOST_AUTO_TEST_CASE(testParsePipelinedRequests)
+{
+  HttpContext context;
+  Buffer input;
+  input.append("GET /a HTTP/1.1\r\n"
+       "Host: www.chenshuo.com\r\n"
+       "\r\n"
+       "GET /b HTTP/1.1\r\n"
+       "Host: www.chenshuo.com\r\n"
+       "\r\n"
+       "GET /c HTTP/1.1\r\n");
+
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK_EQUAL(context.request().path(), string("/a"));
+  BOOST_CHECK_EQUAL(context.request().body_, string(""));
+  context.reset();
+
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK_EQUAL(context.request().path(), string("/b"));
+  context.reset();
+
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(!context.gotAll());
+  input.append("\r\n");
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK_EQUAL(context.request().path(), string("/c"));
+  BOOST_CHECK_EQUAL(input.readableBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(testParseContentLengthBody)
+{
+  string all("POST /upload HTTP/1.1\r\n"
+       "Host: www.chenshuo.com\r\n"
+       "content-length: 11\r\n"
+       "\r\n"
+       "hello world"
+       "GET /next HTTP/1.1\r\n"
+       "\r\n");
+
+  for (size_t sz1 = 0; sz1 < all.size(); ++sz1)
+  {
+    HttpContext context;
+    Buffer input;
+    input.append(all.c_str(), sz1);
+    BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+    input.append(all.c_str() + sz1, all.size() - sz1);
+    BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+    BOOST_CHECK(context.gotAll());
+    BOOST_CHECK_EQUAL(context.request().method(), HttpRequest::kPost);
+    BOOST_CHECK_EQUAL(context.request().body_, string("hello world"));
+    context.reset();
+
+    BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+    BOOST_CHECK(context.gotAll());
+    BOOST_CHECK_EQUAL(context.request().path(), string("/next"));
+    BOOST_CHECK_EQUAL(context.request().body_, string(""));
+    BOOST_CHECK_EQUAL(input.readableBytes(), 0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testParseChunkedBody)
+{
+  string all("POST /upload HTTP/1.1\r\n"
+       "Transfer-Encoding: chunked\r\n"
+       "\r\n"
+       "5\r\nhello\r\n"
+       "1;name=value\r\n \r\n"
+       "A\r\n0123456789\r\n"
+       "0\r\n"
+       "Trailer: ignored\r\n"
+       "\r\n");
+
+  // 逐字节到达
+  HttpContext context;
+  string streamed;
+  int pieces = 0;
+  context.setBodyCallback([&](const HttpRequestView& request, const char* data, size_t len) {
+    BOOST_CHECK(request.path() == "/upload");
+    streamed.append(data, len);
+    ++pieces;
+  });
+  Buffer input;
+  for (size_t i = 0; i < all.size(); ++i)
+  {
+    BOOST_CHECK(!context.gotAll());
+    input.append(all.c_str() + i, 1);
+    BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  }
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK_EQUAL(streamed, string("hello 0123456789"));
+  BOOST_CHECK_EQUAL(pieces, 16);
+  BOOST_CHECK_EQUAL(context.request().body_, string(""));
+  BOOST_CHECK_EQUAL(input.readableBytes(), 0);
+
+  // 一次到达
+  HttpContext whole;
+  input.append(all);
+  BOOST_CHECK(whole.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(whole.gotAll());
+  BOOST_CHECK_EQUAL(whole.request().body_, string("hello 0123456789"));
+}
+
+BOOST_AUTO_TEST_CASE(testParseBadBodyFraming)
+{
+  const char* bad[] = {
+    "POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+    "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1\r\nab\r\n",
+  };
+  for (const char* request : bad)
+  {
+    HttpContext context;
+    Buffer input;
+    input.append(request);
+    BOOST_CHECK(!context.parseRequest(&input, Timestamp::now()));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testRequestView)
+{
+  HttpContext context;
+  Buffer input;
+  input.append("POST /search?q=muduo HTTP/1.0\r\n"
+       "Host: www.chenshuo.com\r\n"
+       "X-Empty:\r\n"
+       "Content-Length: 4\r\n"
+       "\r\n"
+       "body");
+  const char* begin = input.peek();
+  const char* end = input.beginWrite();
+
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK_EQUAL(input.readableBytes(), 0);
+  const HttpRequestView& view = context.requestView();
+  BOOST_CHECK_EQUAL(view.method(), HttpRequest::kPost);
+  BOOST_CHECK_EQUAL(view.getVersion(), HttpRequest::kHttp10);
+  BOOST_CHECK(view.path() == "/search");
+  BOOST_CHECK(view.query() == "?q=muduo");
+  BOOST_CHECK(view.getHeader("host") == "www.chenshuo.com");
+  BOOST_CHECK(view.getHeader("X-Empty").empty());
+  BOOST_CHECK(view.getHeader("Accept").empty());
+  BOOST_CHECK(view.body() == "body");
+  BOOST_CHECK_EQUAL(view.headerCount(), 3);
+  BOOST_CHECK(view.header(2).field == "Content-Length");
+  BOOST_CHECK(view.header(2).value == "4");
+  // 没有复制, 指向Buffer中的数据
+  BOOST_CHECK(view.path().data() >= begin && view.path().end() <= end);
+  BOOST_CHECK(view.body().data() >= begin && view.body().end() <= end);
+
+  HttpRequest request = view.materialize();
+  input.append(string(end - begin, 'x'));  // 覆盖原来的数据
+  BOOST_CHECK_EQUAL(request.path(), string("/search"));
+  BOOST_CHECK_EQUAL(request.query(), string("?q=muduo"));
+  BOOST_CHECK_EQUAL(request.getHeader("Host"), string("www.chenshuo.com"));
+  BOOST_CHECK_EQUAL(request.body_, string("body"));
+}
+
+BOOST_AUTO_TEST_CASE(testRequestViewAfterBufferMoves)
+{
+  string head("GET /index.html HTTP/1.1\r\n"
+       "Host: www.chenshuo.com\r\n");
+  HttpContext context;
+  Buffer input;
+  input.append(string(1000, 'p'));
+  input.retrieve(1000);  // 前面留出空间, 之后的append会把数据搬到开头
+  input.append(head);
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(!context.gotAll());
+  input.append(string("User-Agent: test\r\nX-Padding: ") + string(input.writableBytes(), 'x') + "\r\n\r\n");
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.gotAll());
+  BOOST_CHECK(context.requestView().path() == "/index.html");
+  BOOST_CHECK(context.requestView().getHeader("Host") == "www.chenshuo.com");
+  BOOST_CHECK(context.requestView().getHeader("User-Agent") == "test");
+}
+
+BOOST_AUTO_TEST_CASE(testTooManyHeaders)
+{
+  HttpContext context;
+  Buffer input;
+  input.append("GET / HTTP/1.1\r\n");
+  for (int i = 0; i <= HttpRequestView::kMaxHeaders; ++i)
+  {
+    input.append("X-Header: value\r\n");
+  }
+  input.append("\r\n");
+  BOOST_CHECK(!context.parseRequest(&input, Timestamp::now()));
+}
+
+BOOST_AUTO_TEST_CASE(testBadHeaderCharacters)
+{
+  const char* bad[] = {
+    "GET / HTTP/1.1\r\nHost : x\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost: x\r\n folded\r\n\r\n",
+    "GET / HTTP/1.1\r\nHo\"st: x\r\n\r\n",
+    "GET / HTTP/1.1\r\n: x\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost: a\x01b\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost: a\nb\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost: a\rb\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost: a\x7f\r\n\r\n",
+    "GET /a\x01b HTTP/1.1\r\n\r\n",
+  };
+  const char* impls[] = { "avx2", "sse4.2", "scalar" };
+  for (const char* impl : impls)
+  {
+    if (!HttpTokenizer::setImplementation(impl))
+    {
+      continue;  // CPU不支持
+    }
+    for (const char* request : bad)
+    {
+      HttpContext context;
+      Buffer input;
+      input.append(request);
+      BOOST_CHECK(!context.parseRequest(&input, Timestamp::now()));
+    }
+  }
+  HttpContext context;
+  Buffer input;
+  input.append("GET / HTTP/1.1\r\nUser-Agent: \t\xe4\xbd\xa0\xe5\xa5\xbd\tok \r\n\r\n");  // HTAB和非ASCII字节可以出现在值中
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.requestView().getHeader("User-Agent") == "\xe4\xbd\xa0\xe5\xa5\xbd\tok");
+}
+
+BOOST_AUTO_TEST_CASE(testTokenizerImplementations)
+{
+  // 各实现在每个位置遇到结束字符时结果一致, 覆盖向量化的块边界和尾部
+  const char* impls[] = { "avx2", "sse4.2", "scalar" };
+  const char stops[] = { '\r', '\0', '\x1f', '\x7f', '\n' };
+  for (const char* impl : impls)
+  {
+    if (!HttpTokenizer::setImplementation(impl))
+    {
+      continue;
+    }
+    BOOST_CHECK_EQUAL(HttpTokenizer::implementation(), string(impl));
+    for (int len = 0; len < 80; ++len)
+    {
+      for (char stop : stops)
+      {
+        string line = "X-Long:" + string(len, 'v');
+        line += stop;
+        line += "\nrest";
+        const char* colon = NULL;
+        const char* crlf = NULL;
+        HttpTokenizer::Result result =
+            HttpTokenizer::scanHeaderLine(line.data(), line.data() + line.size(), &colon, &crlf);
+        if (stop == '\r')
+        {
+          BOOST_CHECK_EQUAL(result, HttpTokenizer::kOk);
+          BOOST_CHECK_EQUAL(colon - line.data(), 6);
+          BOOST_CHECK_EQUAL(crlf - line.data(), 7 + len);
+        }
+        else
+        {
+          BOOST_CHECK_EQUAL(result, HttpTokenizer::kInvalid);
+        }
+        // 还没收到行尾
+        result = HttpTokenizer::scanHeaderLine(line.data(), line.data() + 7 + len, &colon, &crlf);
+        BOOST_CHECK_EQUAL(result, HttpTokenizer::kIncomplete);
+      }
+      string target = "/" + string(len, 'p') + " HTTP/1.1";
+      BOOST_CHECK(HttpTokenizer::scanTarget(target.data(), target.data() + target.size()) == target.data() + 1 + len);
+      target[len / 2] = '\x01';
+      BOOST_CHECK(HttpTokenizer::scanTarget(target.data(), target.data() + target.size()) == NULL);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testResponseSerialization)
+{
+  HttpResponse response(false);
+  response.setStatusCode(HttpResponse::k200Ok);
+  response.setStatusMessage("OK");
+  response.setContentType("text/plain");
+  response.addHeader("Server", "Muduo");
+  response.setContentType("text/html");  // 替换
+  response.setBody("hello");
+  BOOST_CHECK(response.getHeader("Content-Type") == "text/html");
+  BOOST_CHECK(response.getHeader("Content").empty());
+
+  Buffer output;
+  response.appendToBuffer(&output);
+  string text = output.retrieveAllAsString();
+  BOOST_CHECK_EQUAL(text.substr(0, 23), string("HTTP/1.1 200 OK\r\nDate: "));
+  BOOST_CHECK_EQUAL(text.substr(48, 25), string(" GMT\r\nContent-Length: 5\r\n"));
+  BOOST_CHECK_EQUAL(text.substr(73), string("Connection: Keep-Alive\r\n"
+                                           "Server: Muduo\r\n"
+                                           "Content-Type: text/html\r\n"
+                                           "\r\n"
+                                           "hello"));
+
+  // 不在枚举中的状态码, 自定义短语, 用户自己的Date
+  HttpResponse custom(true);
+  custom.setStatusCode(static_cast<HttpResponse::HttpStatusCode>(429));
+  custom.addHeader("Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+  custom.setBody("x");
+  custom.appendToBuffer(&output);
+  BOOST_CHECK_EQUAL(output.retrieveAllAsString(),
+                    string("HTTP/1.1 429 Too Many Requests\r\n"
+                           "Connection: close\r\n"
+                           "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+                           "\r\n"
+                           "x"));
+  custom.setStatusMessage("Slow Down");
+  custom.appendToBuffer(&output);
+  BOOST_CHECK_EQUAL(output.retrieveAllAsString().substr(0, 25), string("HTTP/1.1 429 Slow Down\r\nC"));
+
+  // 头部超过内联的容量
+  HttpResponse large(false);
+  large.setStatusCode(HttpResponse::k404NotFound);
+  string cookie(HttpResponse::kInlineHeaderBytes, 'c');
+  large.addHeader("Server", "Muduo");
+  large.addHeader("Set-Cookie", cookie);
+  large.addHeader("Server", "Muduo2");
+  BOOST_CHECK(large.getHeader("Set-Cookie") == cookie);
+  large.appendToBuffer(&output);
+  text = output.retrieveAllAsString();
+  BOOST_CHECK_EQUAL(text.substr(0, 24), string("HTTP/1.1 404 Not Found\r\n"));
+  BOOST_CHECK(text.find("\r\nSet-Cookie: " + cookie + "\r\nServer: Muduo2\r\n\r\n") != string::npos);
+  BOOST_CHECK(text.find("Content-Length: 0\r\n") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(testBodyLimits)
+{
+  // Content-Length超过上限, 不等body到齐就失败
+  HttpContext context;
+  context.setMaxBodySize(16);
+  Buffer input;
+  input.append("POST /upload HTTP/1.1\r\n"
+               "Content-Length: 17\r\n"
+               "\r\n");
+  BOOST_CHECK(!context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.bodyTooLarge());
+
+  context.reset();
+  BOOST_CHECK(!context.bodyTooLarge());
+  input.retrieveAll();
+  input.append("POST /upload HTTP/1.1\r\n"
+               "Content-Length: 16\r\n"
+               "\r\n"
+               "0123456789abcdef");
+  BOOST_CHECK(context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.gotAll());
+
+  // chunked按解码后的累计长度计算
+  context.reset();
+  input.retrieveAll();
+  input.append("POST /upload HTTP/1.1\r\n"
+               "Transfer-Encoding: chunked\r\n"
+               "\r\n"
+               "a\r\n0123456789\r\n"
+               "7\r\n");
+  BOOST_CHECK(!context.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(context.bodyTooLarge());
+
+  // 没有CRLF的超长chunk-size行
+  HttpContext chunkLine;
+  input.retrieveAll();
+  input.append("POST /upload HTTP/1.1\r\n"
+               "Transfer-Encoding: chunked\r\n"
+               "\r\n"
+               "1;ext=");
+  BOOST_CHECK(chunkLine.parseRequest(&input, Timestamp::now()));
+  input.append(string(HttpContext::kMaxChunkSizeLine, 'x'));
+  BOOST_CHECK(!chunkLine.parseRequest(&input, Timestamp::now()));
+  BOOST_CHECK(!chunkLine.bodyTooLarge());
+
+  // trailer合计超过头部的上限
+  HttpContext trailer;
+  input.retrieveAll();
+  input.append("POST /upload HTTP/1.1\r\n"
+               "Transfer-Encoding: chunked\r\n"
+               "\r\n"
+               "0\r\n");
+  BOOST_CHECK(trailer.parseRequest(&input, Timestamp::now()));
+  bool failed = false;
+  for (size_t sent = 0; sent <= HttpContext::kMaxHeaderBytes && !failed; sent += 1024)
+  {
+    input.append("X-Trailer: " + string(1024 - 13, 't') + "\r\n");
+    failed = !trailer.parseRequest(&input, Timestamp::now());
+  }
+  BOOST_CHECK(failed);
+  BOOST_CHECK(!trailer.gotAll());
+}
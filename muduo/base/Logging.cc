@@ -97,6 +97,7 @@ void defaultFlush()
 /// 设置输出和刷函数
 Logger::OutputFunc g_output = defaultOutput;
 Logger::FlushFunc g_flush = defaultFlush;
+Logger::ClockFunc g_clock = Timestamp::now;
 
 //时区
 TimeZone g_logTimeZone;
@@ -107,7 +108,7 @@ using namespace muduo;
 
 // 设置Logger的level, file
 Logger::Impl::Impl(LogLevel level, int savedErrno, const SourceFile& file, int line)
-  : time_(Timestamp::now()),
+  : time_(g_clock()),
     stream_(),
     level_(level),
     line_(line),
@@ -238,3 +239,8 @@ void Logger::setTimeZone(const TimeZone& tz)
 {
   g_logTimeZone = tz;
 }
+// 设置取日志时间的函数
+void Logger::setClock(ClockFunc clock)
+{
+  g_clock = clock;
+}
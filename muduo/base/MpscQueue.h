@@ -0,0 +1,304 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+
+// MpscQueue 无锁多生产者单消费者队列
+// 基于Dmitry Vyukov的intrusive MPSC node-based queue:
+// 生产者只做一次原子exchange(tail_)和一次store(next), 不需要锁;
+// 消费者只能有一个(EventLoop所属线程), 从head_一路弹出, 可以批量取走。
+// 节点来自队列自己的节点池: 消费者取走任务后把节点放回空闲栈, 生产者从栈顶取,
+// 稳定后push/pop不再调用new/delete(原来每次跨线程投递都是一对malloc/free, 且在不同线程)。
+
+#ifndef MUDUO_BASE_MPSCQUEUE_H
+#define MUDUO_BASE_MPSCQUEUE_H
+
+#include "muduo/base/Mutex.h"
+#include "muduo/base/noncopyable.h"
+
+#include <atomic>
+#include <utility>
+
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+
+namespace muduo
+{
+
+template<typename T>
+class MpscQueue : noncopyable
+{
+ public:
+  MpscQueue()
+    : head_(&stub_),
+      tail_(&stub_),
+      size_(0),
+      freeTop_(kNil),
+      numChunks_(0)
+  {
+    for (std::atomic<Node*>& chunk : chunks_)
+    {
+      chunk.store(NULL, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpscQueue()
+  {
+    T dummy;
+    while (pop(&dummy))
+    {
+    }
+    for (size_t i = 0; i < numChunks_.load(std::memory_order_relaxed); ++i)
+    {
+      delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  /// 任意线程调用, lock-free; 节点池用完时加锁扩充一块(启动和突发时才有)
+  void push(T x)
+  {
+    Node* node = allocNode();
+    node->value = std::move(x);
+    size_.fetch_add(1, std::memory_order_relaxed);
+    Node* prev = tail_.exchange(node);  // 先抢占tail_, 再把前驱链接过来; seq_cst, 与EventLoop的wakeup标志构成全序
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  /// 只能由消费者线程调用, 队列为空返回false
+  bool pop(T* out)
+  {
+    Node* node = popNode();
+    if (node == NULL)
+    {
+      return false;
+    }
+    *out = std::move(node->value);
+    Node* first = NULL;
+    Node* last = NULL;
+    recycle(node, &first, &last);
+    if (first)
+    {
+      pushFree(first, last);
+    }
+    return true;
+  }
+
+  /// 批量取出调用时刻队列中已有的全部任务(以当时的tail_为界), 对每个任务调用f, 返回取出的个数。
+  /// 之后才入队的任务留给下一次drain, 其生产者必然能观察到调用者在此之前做的seq_cst写(如清除唤醒标志)
+  template<typename F>
+  size_t drain(F&& f)
+  {
+    Node* last = tail_.load();
+    // tail_是哨兵不代表队列为空: pushStub()之前有生产者抢到tail_时, 队列是head_ -> ... -> stub_,
+    // 这时界限是哨兵之前的节点, 取到head_回到哨兵为止; 只有head_也是哨兵才是空的
+    if (last == &stub_ && head_ == &stub_)
+    {
+      return 0;
+    }
+    size_t n = 0;
+    bool done = false;
+    Node* freeFirst = NULL;  // 取走的节点先串起来, 最后一次放回空闲栈
+    Node* freeLast = NULL;
+    while (!done)
+    {
+      Node* node = popNode();
+      assert(node != NULL);  // last还在队列中, 前面的节点迟早会链接上
+      T x(std::move(node->value));
+      done = (last == &stub_) ? (head_ == &stub_) : (node == last);
+      recycle(node, &freeFirst, &freeLast);
+      f(x);
+      ++n;
+    }
+    if (freeFirst)
+    {
+      pushFree(freeFirst, freeLast);
+    }
+    return n;
+  }
+
+  /// 近似值, 任意线程可读
+  size_t size() const
+  { return size_.load(std::memory_order_relaxed); }
+
+  bool empty() const
+  { return size() == 0; }
+
+  /// 节点池中的节点总数(空闲加上在用的), 不包括池满后临时new的节点
+  size_t pooledNodes() const
+  { return numChunks_.load(std::memory_order_relaxed) * kChunkNodes; }
+
+ private:
+  static const uint32_t kNil = 0xffffffff;
+  static const size_t kChunkNodes = 256;  // 每次扩充的节点数
+  static const size_t kMaxChunks = 256;  // 节点池上限65536个节点, 超出的直接new/delete
+
+  struct Node
+  {
+    Node() : next(NULL), freeNext(kNil), index(kNil), value() {}
+
+    std::atomic<Node*> next;
+    std::atomic<uint32_t> freeNext;  // 在空闲栈中时, 下一个空闲节点的编号
+    uint32_t index;  // 在节点池中的编号, kNil表示不属于节点池
+    T value;
+  };
+
+  Node* nodeAt(uint32_t index) const
+  {
+    return chunks_[index / kChunkNodes].load(std::memory_order_acquire) + index % kChunkNodes;
+  }
+
+  /// 空闲栈顶是一个64位值: 高32位是版本号, 每次修改加一, 避免ABA(栈顶节点被别的生产者取走又放回时CAS失败);
+  /// 低32位是节点编号。节点直到队列析构才释放, 读到过时的栈顶时读freeNext也是安全的
+  static uint64_t makeTop(uint64_t top, uint32_t index)
+  { return (((top >> 32) + 1) << 32) | index; }
+
+  /// 生产者调用
+  Node* allocNode()
+  {
+    Node* node = popFree();
+    return node ? node : grow();
+  }
+
+  Node* popFree()
+  {
+    uint64_t top = freeTop_.load(std::memory_order_acquire);
+    for (;;)
+    {
+      uint32_t index = static_cast<uint32_t>(top);
+      if (index == kNil)
+      {
+        return NULL;
+      }
+      Node* node = nodeAt(index);
+      uint32_t next = node->freeNext.load(std::memory_order_relaxed);
+      if (freeTop_.compare_exchange_weak(top, makeTop(top, next),
+                                         std::memory_order_acquire, std::memory_order_acquire))
+      {
+        return node;
+      }
+    }
+  }
+
+  /// 空闲栈为空: 加锁新建一块节点, 取第一个, 其余放入空闲栈
+  Node* grow()
+  {
+    MutexLockGuard lock(growMutex_);
+    Node* node = popFree();  // 等锁期间别的生产者可能已经扩充过
+    if (node)
+    {
+      return node;
+    }
+    size_t n = numChunks_.load(std::memory_order_relaxed);
+    if (n == kMaxChunks)
+    {
+      return new Node;
+    }
+    Node* chunk = new Node[kChunkNodes];
+    for (size_t i = 0; i < kChunkNodes; ++i)
+    {
+      chunk[i].index = static_cast<uint32_t>(n * kChunkNodes + i);
+      chunk[i].freeNext.store(i + 1 < kChunkNodes ? chunk[i].index + 1 : kNil,
+                              std::memory_order_relaxed);
+    }
+    chunks_[n].store(chunk, std::memory_order_release);
+    numChunks_.store(n + 1, std::memory_order_relaxed);
+    if (kChunkNodes > 1)
+    {
+      pushFree(&chunk[1], &chunk[kChunkNodes - 1]);
+    }
+    return &chunk[0];
+  }
+
+  /// 把[first, last]这一串已经用freeNext链好的节点放回空闲栈
+  void pushFree(Node* first, Node* last)
+  {
+    uint64_t top = freeTop_.load(std::memory_order_relaxed);
+    do
+    {
+      last->freeNext.store(static_cast<uint32_t>(top), std::memory_order_relaxed);
+    } while (!freeTop_.compare_exchange_weak(top, makeTop(top, first->index),
+                                             std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  /// 消费者调用, 节点的值已经移走。池中的节点串到[*first, *last]的前面, 由调用者用pushFree()放回
+  static void recycle(Node* node, Node** first, Node** last)
+  {
+    if (node->index == kNil)
+    {
+      delete node;
+      return;
+    }
+    node->next.store(NULL, std::memory_order_relaxed);
+    node->freeNext.store(*first ? (*first)->index : kNil, std::memory_order_relaxed);
+    *first = node;
+    if (*last == NULL)
+    {
+      *last = node;
+    }
+  }
+
+  /// 生产者在exchange和store next之间被打断时, 队列处于"断链"状态, 这里自旋等待链接完成, 保证不丢任务
+  Node* popNode()
+  {
+    Node* head = head_;
+    Node* next = head->next.load(std::memory_order_acquire);
+    if (head == &stub_)  // 跳过哨兵节点
+    {
+      if (next == NULL)
+      {
+        if (tail_.load() == &stub_)
+        {
+          return NULL;
+        }
+        next = waitNext(head);
+      }
+      head_ = next;
+      head = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next == NULL)
+    {
+      if (head == tail_.load())
+      {
+        pushStub();  // head是最后一个节点, 放回哨兵使head可以被取走
+      }
+      next = waitNext(head);  // 有生产者正在链接
+    }
+
+    head_ = next;
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    return head;
+  }
+
+  void pushStub()
+  {
+    stub_.next.store(NULL, std::memory_order_relaxed);
+    Node* prev = tail_.exchange(&stub_);
+    prev->next.store(&stub_, std::memory_order_release);
+  }
+
+  static Node* waitNext(Node* node)
+  {
+    Node* next = NULL;
+    while ((next = node->next.load(std::memory_order_acquire)) == NULL)
+    {
+      ::sched_yield();
+    }
+    return next;
+  }
+
+  Node* head_;  // 只有消费者访问
+  char pad_[64];  // head_与tail_分处不同cache line, 避免生产者和消费者伪共享
+  std::atomic<Node*> tail_;
+  std::atomic<size_t> size_;
+  Node stub_;
+
+  std::atomic<uint64_t> freeTop_;  // 空闲栈顶, 见makeTop()
+  std::atomic<Node*> chunks_[kMaxChunks];  // 节点池, 编号i的节点在chunks_[i / kChunkNodes]中
+  std::atomic<size_t> numChunks_;
+  MutexLock growMutex_;
+};
+
+}  // namespace muduo
+
+#endif  // MUDUO_BASE_MPSCQUEUE_H
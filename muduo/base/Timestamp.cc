@@ -1,6 +1,7 @@
 #include "muduo/base/Timestamp.h"
 
 #include <sys/time.h>
+#include <time.h>
 #include <stdio.h>
 
 #ifndef __STDC_FORMAT_MACROS
@@ -56,3 +57,11 @@ Timestamp Timestamp::now()
   return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
+Timestamp Timestamp::monotonicNow()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  int64_t seconds = ts.tv_sec;
+  return Timestamp(seconds * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
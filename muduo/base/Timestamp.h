@@ -66,6 +66,13 @@ class Timestamp : public muduo::copyable,
   ///
   /// 当前时间戳
   static Timestamp now();
+
+  ///
+  /// Get time of now from the monotonic clock.
+  ///
+  /// 单调时钟(CLOCK_MONOTONIC)的当前时刻, 从开机算起, 不随系统时间的调整跳变。
+  /// 只能和同一时钟的时刻比较或者算时间差, 不能格式化成日期。glibc经vDSO在用户态读TSC, 没有系统调用
+  static Timestamp monotonicNow();
   static Timestamp invalid()
   {
     return Timestamp();
@@ -76,11 +76,15 @@ class Logger
   typedef void (*OutputFunc)(const char* msg, int len);
   // Flushh函数
   typedef void (*FlushFunc)();
+  // 取日志时间的函数
+  typedef Timestamp (*ClockFunc)();
 
   // 设置函数
   static void setOutput(OutputFunc);
   static void setFlush(FlushFunc);
   static void setTimeZone(const TimeZone& tz);
+  /// 默认Timestamp::now(); IO线程多的程序可以设成EventLoop::cachedNow, 日志时间精确到一轮循环, 不再每条日志取一次时间
+  static void setClock(ClockFunc);
 
  private:
 
@@ -4,6 +4,8 @@
 #include <functional>
 #include <memory>
 
+#include <assert.h>
+
 #include "muduo/base/noncopyable.h"
 #include "muduo/base/Timestamp.h"
 
@@ -50,6 +52,36 @@ class Channel : noncopyable
 
   int fd() const { return fd_; }  // Channel的fd_
   int events() const { return events_; }  // Channel负责的事件
+  int pollEvents() const { return pollEvents_; }  // 实际注册到poller的事件, 水平触发时与events_相同
+
+  /// 边沿触发(EPOLLET), 需要在注册到poller之前设置, 只有EPollPoller支持。
+  /// 可写事件随可读事件一起常驻注册, enableWriting()/disableWriting()只改events_, 不再调用epoll_ctl;
+  /// 回调必须把数据读写到EAGAIN为止, 否则不会再有通知
+  void setEdgeTriggered(bool on) { assert(!addedToLoop_); edgeTriggered_ = on; }
+  bool edgeTriggered() const { return edgeTriggered_; }
+
+  /// 异步读写(EventLoop::supportsAsyncIo()), 需要在注册到poller之前设置。
+  /// poller不再为它等待可读: 读由所有者用EventLoop::asyncRead()提交, 完成时revents带POLLIN,
+  /// 读到的数据见asyncReadData()/asyncReadResult(); asyncWrite()完成时revents带POLLOUT,
+  /// takeAsyncWriteResult()返回true。enableWriting()仍然等待可写, 供不能异步写的数据(文件段)使用
+  void setAsyncIo(bool on) { assert(!addedToLoop_); asyncIo_ = on; }
+  bool asyncIo() const { return asyncIo_; }
+
+  // for Poller: 异步读写的结果, res是字节数或者-errno
+  void setAsyncReadResult(const char* data, int res) { asyncReadData_ = data; asyncReadResult_ = res; }
+  void setAsyncWriteResult(int res) { asyncWriteResult_ = res; asyncWriteDone_ = true; }
+
+  /// 读到的数据在poller的缓冲区中, 只在本次回调中有效
+  const char* asyncReadData() const { return asyncReadData_; }
+  int asyncReadResult() const { return asyncReadResult_; }
+  /// 本次事件中有写完成时返回true并取走结果
+  bool takeAsyncWriteResult(int* res)
+  {
+    bool done = asyncWriteDone_;
+    *res = asyncWriteResult_;
+    asyncWriteDone_ = false;
+    return done;
+  }
 
   void set_revents(int revt) { revents_ = revt; } // poll返回的事件used by pollers
   bool isNoneEvent() const { return events_ == kNoneEvent; }  // 空事件
@@ -95,9 +127,16 @@ class Channel : noncopyable
   const int  fd_; // Channel维护的fd
 
   int        events_; // Channel监听的事件, 在enableReading, enableWriting设置并调用loop::updatechannel将Channel(主要是event和fd)注册到poller
+  int        pollEvents_;  // 上一次注册到poller的事件
   int        revents_;   // poll 传回的事件
   int        index_;   // poll要对fd进行的操作，例如kdeleted等
   bool       logHup_;
+  bool       edgeTriggered_;
+  bool       asyncIo_;
+  bool       asyncWriteDone_;
+  int        asyncReadResult_;
+  int        asyncWriteResult_;
+  const char* asyncReadData_;
 
   std::weak_ptr<void> tie_; // 用weakptr链接TcpConnection
   bool tied_;
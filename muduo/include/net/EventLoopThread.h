@@ -21,8 +21,10 @@ class EventLoopThread : noncopyable
  /// eventloop thread创建之后的回调函数, 参数为void(EventLoop*)
   typedef std::function<void(EventLoop*)> ThreadInitCallback;
 
+  /// cpu >= 0时线程绑定到该CPU, 并在绑定之后才创建EventLoop, loop的内存都从该CPU所在的NUMA node分配
   EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),
-                  const string& name = string());
+                  const string& name = string(),
+                  int cpu = -1);
   ~EventLoopThread();
   EventLoop* startLoop();
 
@@ -37,6 +39,7 @@ class EventLoopThread : noncopyable
   MutexLock mutex_; // 持有锁对象
   Condition cond_ GUARDED_BY(mutex_); // 持有条件变量对象, 使用之必须先获得mutex_
   ThreadInitCallback callback_;
+  const int cpu_;  // 小于0表示不绑定
 };
 
 }  // namespace net
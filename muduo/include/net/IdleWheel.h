@@ -0,0 +1,60 @@
+#ifndef MUDUO_NET_IDLEWHEEL_H_
+#define MUDUO_NET_IDLEWHEEL_H_
+
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/TimerId.h"
+
+namespace muduo
+{
+namespace net
+{
+
+class EventLoop;
+class TcpConnection;
+
+///
+/// Idle connection expiry wheel.
+/// 空闲连接的时间轮, TcpServer每个IO loop一个, 只在所属loop线程中使用。
+///
+/// 超时时间被切成kTicksPerTimeout个tick, 整个loop只有一个runEvery定时器驱动。
+/// 连接按"最后活跃的tick + 超时"挂在对应槽的侵入式链表上, 不持有连接(弱引用), 连接关闭时摘除。
+/// 读写只记下当前tick(一次赋值, 不移动链表也不分配内存); 槽到期时才检查其中的连接,
+/// 期间活跃过的挪到新的槽, 真正空闲的一批关闭。实际超时在(timeout, timeout * 9/8]之间。
+///
+class IdleWheel : noncopyable
+{
+ public:
+  static const int kTicksPerTimeout = 8;
+
+  IdleWheel(EventLoop* loop, double timeoutSeconds);
+  ~IdleWheel();  // 剩下的连接只摘除, 不关闭
+
+  void add(TcpConnection* conn);
+  /// 连接不在时间轮中(比如已经因为超时被摘除)时什么也不做
+  void remove(TcpConnection* conn);
+
+  int64_t currentTick() const { return currentTick_; }
+  size_t size() const { return size_; }
+
+ private:
+  void onTick();
+  void link(TcpConnection* conn);
+  void unlink(TcpConnection* conn);
+
+  EventLoop* loop_;
+  TimerId timer_;
+  int64_t currentTick_;
+  size_t size_;
+  std::vector<TcpConnection*> slots_;  // 每个槽是双向链表的头, 槽数kTicksPerTimeout + 2
+  std::vector<std::shared_ptr<TcpConnection>> expired_;  // onTick中复用
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_IDLEWHEEL_H_
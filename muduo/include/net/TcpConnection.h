@@ -2,13 +2,17 @@
 #define MUDUO_NET_TCPCONNECTION_H_
 
 #include <memory>
+#include <mutex>
 #include <boost/any.hpp>
 
+#include "muduo/base/Mutex.h"
 #include "muduo/base/noncopyable.h"
 #include "muduo/base/StringPiece.h"
 #include "muduo/base/Types.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Buffer.h"
+#include "muduo/net/ChainBuffer.h"
+#include "muduo/net/IdleWheel.h"
 #include "muduo/net/InetAddress.h"
 
 struct tcp_info;  // tcp_info的信息
@@ -21,6 +25,7 @@ namespace net
 // 更上一层的Tcp连接
 // 用户编写的回调函数位于此, TcpConnection再将注册到到Channel中
 
+class BufferPool;
 class Channel;
 class EventLoop;
 class Socket;
@@ -30,17 +35,28 @@ class TcpConnection : noncopyable,
                       public std::enable_shared_from_this<TcpConnection>  // 可使用shared_from_this
 {
  public:
+  /// 边沿触发模式下一次可读/可写事件最多读写的字节数, 超出的部分排到本轮其他连接之后
+  static const size_t kEdgeTriggeredBudget = 256 * 1024;
+
   /// Constructs a TcpConnection with a connected sockfd
   TcpConnection(EventLoop* loop,  
                 const string& name,
                 int sockfd,
                 const InetAddress& localAddr,
                 const InetAddress& peerAddr);
+  /// TcpServer使用: 名字为*namePrefix + id, 第一次调用name()时才格式化
+  TcpConnection(EventLoop* loop,
+                const std::shared_ptr<const string>& namePrefix,
+                uint64_t id,
+                int sockfd,
+                const InetAddress& localAddr,
+                const InetAddress& peerAddr);
   ~TcpConnection();
 
   // connection的loop_
   EventLoop* getLoop() const { return loop_; }
-  const string& name() const { return name_; }
+  const string& name() const;  // 线程安全
+  uint64_t id() const { return id_; }  // TcpServer中唯一, 其他方式创建的连接为0
   const InetAddress& localAddress() const { return localAddr_; }
   const InetAddress& peerAddress() const { return peerAddr_; }
 
@@ -50,15 +66,37 @@ class TcpConnection : noncopyable,
   bool getTcpInfo(struct tcp_info*) const;  
   string getTcpInfoString() const;  // tcpinfo信息
 
+  // 任意线程可调用。在其他线程调用时数据追加到一个加锁的待发送链上, 同一连接排队的多次send合并成一个loop任务
   void send(const void* message, int len);   // 发送message
   void send(const StringPiece& message);
+  void send(const char* message) { send(StringPiece(message)); }
+  void send(string&& message);  // 大块数据在其他线程调用时不拷贝, 移到一个共享的string里挂到链上
   void send(Buffer* message);  // this one will swap data
+  void send(Buffer&& message) { send(&message); }
+  /// 引用计数的数据片, 比如发给很多连接的同一份数据: 只增加引用计数, 写完之前message保持不变
+  void send(const std::shared_ptr<const string>& message);
+  /// 发送文件区域[offset, offset+len), 排在已发送的数据之后, 可写时用sendfile(2)在内核中发送。
+  /// 内部dup一份fd, 调用者可以立即close。发送完成同样回调writeCompleteCallback_
+  void sendFile(int fd, off_t offset, size_t len);
 
   void shutdown(); // NOT thread safe, no simultaneous calling
   // void shutdownAndForceCloseAfter(double seconds); // NOT thread safe, no simultaneous calling
   void forceClose();
   void forceCloseWithDelay(double seconds);
   void setTcpNoDelay(bool on);
+  /// 见Socket::setBusyPoll, 配合EventLoop::setBusyPoll()使用
+  void setBusyPoll(int usec);
+  /// 不小于threshold字节的数据段(send(Buffer*)整体移交的大块数据)用MSG_ZEROCOPY发送, 0表示关闭。
+  /// 数据在内核发完完成通知之前一直保留。在loop线程中调用, 一般在连接回调里
+  void setZeroCopyThreshold(size_t threshold);
+  /// 使用边沿触发: 每次事件读写到EAGAIN(或用完kEdgeTriggeredBudget)为止, 省去epoll_wait往返和
+  /// 开关可写事件的epoll_ctl。必须在connectEstablished()之前调用, loop的poller不支持时忽略
+  void setEdgeTriggered(bool on);
+  bool edgeTriggered() const { return edgeTriggered_; }
+  /// 自动cork: 在loop线程中的send只追加到outputBuffer_, 本轮事件循环结束时用一次writev写出,
+  /// 分几次写出的响应、流水线上的多个响应合并成一次系统调用和更少的TCP段。在loop线程中调用
+  void setAutoCork(bool on) { autoCork_ = on; }
+  bool autoCork() const { return autoCork_; }
   // reading or not
   void startRead();
   void stopRead();
@@ -88,9 +126,18 @@ class TcpConnection : noncopyable,
   void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark)
   { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
 
-  Buffer* inputBuffer() // 可读的信息会自动读取放入inputBuffer中
+  /// 读流控: outputBuffer_超过highWaterMark字节时自动停止读(stopReadInLoop), 写到不超过lowWaterMark时恢复。
+  /// 对端读得慢时, 本连接的输出缓冲不会无限增长, 也不再从对端读入新的请求。highWaterMark为0表示关闭。
+  /// 期间用户调用了startRead()/stopRead()的, 以用户的为准。在loop线程中调用
+  void setReadBackpressure(size_t highWaterMark, size_t lowWaterMark)
+  { backpressureHigh_ = highWaterMark; backpressureLow_ = lowWaterMark; }
+  bool readPausedByBackpressure() const { return readPausedByBackpressure_; }
+
+
+  // 在TcpConnection中维护了输入缓存和输出缓存, 
+  Buffer* inputBuffer() // 可读的信息会自动读取放入inputBuffer中, 处理完(可读为空)后存储会还给loop的缓冲区池
   { return &inputBuffer_; }
-  Buffer* outputBuffer()  // 写出的信息先放入outputBuffer
+  ChainBuffer* outputBuffer()  // 写出的信息先放入outputBuffer, 分段链式缓存, 追加不移动已有数据
   { return &outputBuffer_; }
 
   /// Internal use only.
@@ -103,15 +150,38 @@ class TcpConnection : noncopyable,
   void connectDestroyed();  // should be called only once
 
  private:
+  friend class IdleWheel;
+
   enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting }; // TcpConnection的连接
 
   void handleRead(Timestamp receiveTime);   // 可读处理函数
+  void handleReadEdgeTriggered(Timestamp receiveTime);
+  void handleReadAsync(Timestamp receiveTime);
   void handleWrite(); // 可写处理
+  void handleWriteAsync(int result);
   void handleClose();
   void handleError();
+  bool handleZeroCopyCompletions();
 
   void sendInLoop(const StringPiece& message);  // 在loop所在的线程中执行
   void sendInLoop(const void* message, size_t len);
+  void sendInLoop(Buffer* buf);  // 没写完的部分整体交给outputBuffer_, 大块不拷贝
+  void sendInLoop(const std::shared_ptr<const string>& message);
+  template<typename Append>
+  void queueSend(Append append);  // 其他线程: 在锁内用append填充pendingSends_
+  void sendPendingInLoop();
+  void flushCorked();  // EventLoop::runAfterIteration的回调
+  /// 有读写, 在空闲时间轮中续期: 只记下当前tick, O(1)且不分配内存
+  void touchIdle()
+  {
+    if (idleWheel_)
+    {
+      idleTick_ = idleWheel_->currentTick();
+    }
+  }
+  void sendFileInLoop(int fd, off_t offset, size_t len);
+  ssize_t writeDirectly(const void* data, size_t len);
+  void queueOutput(size_t len);
   void shutdownInLoop();
 
   void forceCloseInLoop();
@@ -119,11 +189,26 @@ class TcpConnection : noncopyable,
   const char* stateToString() const;
   void startReadInLoop();
   void stopReadInLoop();
+  void resumeReadIfDrained();  // 写出数据之后检查低水位
+  void submitAsyncRead();
+  bool submitAsyncWrite();  // outputBuffer_开头是文件段时返回false, 由调用者走同步写
+  void finishAsyncIo();  // connectDestroyed之后的最后一个异步操作完成时调用
 
   EventLoop* loop_; // TcpConnection所属的EventLoop
-  const string name_;
+  const uint64_t id_;
+  const std::shared_ptr<const string> namePrefix_;
+  mutable std::once_flag nameOnce_;
+  mutable string name_;
   StateE state_;  // FIXME: use atomic variable
   bool reading_;
+  bool edgeTriggered_;
+  bool autoCork_;
+  bool corkFlushQueued_;  // 本轮已经登记了flushCorked
+  // loop的poller支持异步读写(io_uring)时, 读写由poller提交, 完成后回到handleRead/handleWrite;
+  // 此时总是自动cork, 每轮的输出合并成一次异步writev
+  const bool asyncIo_;
+  bool readInFlight_;
+  bool writeInFlight_;
 
   std::unique_ptr<Socket> socket_;  // socket unique_ptr
   std::unique_ptr<Channel> channel_;  // TcpConnection的Channel通道
@@ -138,12 +223,32 @@ class TcpConnection : noncopyable,
   HighWaterMarkCallback highWaterMarkCallback_;
   CloseCallback closeCallback_; // 连接关闭回调函数
   size_t highWaterMark_;
+  size_t backpressureHigh_;  // 0表示不做读流控
+  size_t backpressureLow_;
+  bool readPausedByBackpressure_;  // 是流控停的读, 写到低水位时由它恢复
+  size_t zeroCopyThreshold_;  // 0表示不使用MSG_ZEROCOPY
 
   // inputBuffer和outputBuffer_, 一个是读缓存, 一个是写缓存
+  // 两者的存储都从loop的bufferPool_借, 读到的数据处理完/写完就还回去, 空闲连接几乎不占缓冲区
+  std::shared_ptr<BufferPool> bufferPool_;
   Buffer inputBuffer_;
-  Buffer outputBuffer_;
+  ChainBuffer outputBuffer_;
+  std::unique_ptr<struct iovec[]> asyncIov_;  // 异步写的iovec, 第一次异步写时分配, 写完成之前内核一直引用
+  std::shared_ptr<TcpConnection> asyncGuard_;  // connectDestroyed时还有异步读写未完成, 等完成后才能删除channel
+
+  // 其他线程send的数据, 不带pool(slab直接new), 由loop线程整体转移到outputBuffer_
+  MutexLock sendMutex_;
+  ChainBuffer pendingSends_ GUARDED_BY(sendMutex_);
+  bool sendQueued_ GUARDED_BY(sendMutex_);  // 已经有一个sendPendingInLoop任务在排队
 
   boost::any context_;  // context
+
+  // 以下由IdleWheel维护
+  IdleWheel* idleWheel_;  // NULL表示不在时间轮中
+  int64_t idleTick_;  // 最后一次读写时时间轮的tick
+  TcpConnection* idlePrev_;
+  TcpConnection* idleNext_;
+  TcpConnection** idleSlot_;  // 所在槽的链表头
 };
 
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;  // 用shared_ptr维护的TcpConnection
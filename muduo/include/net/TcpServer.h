@@ -1,20 +1,24 @@
 #ifndef MUDUO_NET_TCPSERVER_H_
 #define MUDUO_NET_TCPSERVER_H_
 
-#include <map>
+#include <unordered_map>
+#include <vector>
 
 #include "muduo/base/Atomic.h"
 #include "muduo/base/Types.h"
+#include "muduo/net/EventLoopThreadPool.h"
 #include "muduo/net/TcpConnection.h"
 
 namespace muduo
 {
+
+class CountDownLatch;
+
 namespace net
 {
 
 class Acceptor;
 class EventLoop;
-class EventLoopThreadPool;
 
 /// TCP server, supports single-threaded and thread-pool models.
 class TcpServer : noncopyable
@@ -25,6 +29,7 @@ class TcpServer : noncopyable
   {
     kNoReusePort,
     kReusePort,
+    kReusePortPerLoop,  // 每个IO loop各自一个SO_REUSEPORT的Acceptor, 在本线程accept并处理连接
   };
 
   TcpServer(EventLoop* loop,
@@ -38,6 +43,10 @@ class TcpServer : noncopyable
   EventLoop* getLoop() const { return loop_; }
 
   void setThreadNum(int numThreads);  // 线程个数
+  /// IO线程绑定CPU, 见EventLoopThreadPool::setThreadCpus()。需要在start()之前调用
+  void setThreadNum(int numThreads, const std::vector<int>& cpus);
+  /// 每个可用CPU一个IO线程并绑定, 代替setThreadNum()。需要在start()之前调用
+  void setOneLoopPerCore();
   void setThreadInitCallback(const ThreadInitCallback& cb)
   { threadInitCallback_ = cb; }
   std::shared_ptr<EventLoopThreadPool> threadPool() // 线程池对象
@@ -57,20 +66,75 @@ class TcpServer : noncopyable
   void setWriteCompleteCallback(const WriteCompleteCallback& cb)
   { writeCompleteCallback_ = cb; }  // 写毕回调函数
 
+  /// kReusePortPerLoop模式下, 用CBPF让内核按收到连接的CPU选择loop。需要在start()之前调用。
+  /// IO线程用setThreadNum(n, cpus)/setOneLoopPerCore()绑定了CPU时, 在哪个CPU上收到就交给绑定在那个CPU的loop,
+  /// 配合网卡RSS/IRQ亲和性, 连接从中断到处理都不离开同一个CPU和NUMA node; 否则按cpu % loop数选择
+  void setReusePortCpuSteering(bool on)
+  { reusePortCpuSteering_ = on; }
+
+  /// 新连接分配给哪个IO loop, 默认轮流分配; 自定义策略收到的hashCode是对端IP的hash。
+  /// 需要在start()之前调用。kReusePortPerLoop模式下由内核分配, 不使用这里的策略
+  void setLoopSelectionPolicy(EventLoopThreadPool::SelectionPolicy policy)
+  { threadPool_->setSelectionPolicy(policy); }
+  void setLoopSelector(const EventLoopThreadPool::LoopSelector& selector)
+  { threadPool_->setLoopSelector(selector); }
+
+  /// IO loop忙轮询最多loopBudgetUs微秒, 见EventLoop::setBusyPoll(); socketBusyPollUs > 0时
+  /// 新连接还设置SO_BUSY_POLL。需要在start()之前调用
+  void setBusyPoll(int loopBudgetUs, int socketBusyPollUs = 0)
+  { busyPollUs_ = loopBudgetUs; socketBusyPollUs_ = socketBusyPollUs; }
+
+  /// 新连接使用边沿触发, 见TcpConnection::setEdgeTriggered()。需要在start()之前调用
+  void setEdgeTriggered(bool on)
+  { edgeTriggered_ = on; }
+
+  /// 新连接打开读流控, 见TcpConnection::setReadBackpressure()。需要在start()之前调用
+  void setReadBackpressure(size_t highWaterMark, size_t lowWaterMark)
+  { backpressureHigh_ = highWaterMark; backpressureLow_ = lowWaterMark; }
+
+  /// 连接超过seconds秒没有读写就关闭(forceClose), 0表示不限制(默认)。需要在start()之前调用。
+  /// 每个IO loop一个IdleWheel和一个定时器, 不给每个连接单独设定时器
+  void setIdleTimeout(double seconds)
+  { idleTimeout_ = seconds; }
+
+  /// 新连接打开自动cork, 见TcpConnection::setAutoCork()。需要在start()之前调用
+  void setAutoCork(bool on)
+  { autoCork_ = on; }
+
  private:
+  struct LoopShard;
+
   /// Not thread safe, but in loop, 新的连接
   void newConnection(int sockfd, const InetAddress& peerAddr);
-  /// Thread safe.
-  void removeConnection(const TcpConnectionPtr& conn);
-  /// Not thread safe, but in loop
-  void removeConnectionInLoop(const TcpConnectionPtr& conn);
-  typedef std::map<string, TcpConnectionPtr> ConnectionMap; // string到tcpconnection的映射
+  /// Not thread safe, but in loop, kReusePortPerLoop模式下IO loop自己accept的新连接
+  void newConnectionInLoop(LoopShard* shard, int sockfd, const InetAddress& peerAddr);
+  TcpConnectionPtr createConnection(LoopShard* shard, uint64_t connId,
+                                    int sockfd, const InetAddress& peerAddr);
+  /// Not thread safe, but in shard's loop, 登记到本loop的连接表并建立连接
+  void establishInLoop(LoopShard* shard, const TcpConnectionPtr& conn);
+  void startShards();
+  void destroyShard(LoopShard* shard, CountDownLatch* latch);
+  /// Not thread safe, but in conn's loop, 连接表按loop分片, 移除不用回到主loop
+  void removeConnection(LoopShard* shard, const TcpConnectionPtr& conn);
+  typedef std::unordered_map<uint64_t, TcpConnectionPtr> ConnectionMap; // 连接id到tcpconnection的映射
 
   EventLoop* loop_;  // the acceptor loop
+  const InetAddress listenAddr_;
   const string ipPort_;
   const string name_;
-
-  std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor
+  const std::shared_ptr<const string> connNamePrefix_;  // "name-ip:port#", 连接名字用到时才拼上id
+  const bool reusePortPerLoop_;
+  bool reusePortCpuSteering_;
+  bool edgeTriggered_;
+  bool autoCork_;
+  double idleTimeout_;
+  size_t backpressureHigh_;
+  size_t backpressureLow_;
+  int busyPollUs_;
+  int socketBusyPollUs_;
+
+  std::unique_ptr<Acceptor> acceptor_; // avoid revealing Acceptor, kReusePortPerLoop模式下为空
+  std::vector<std::unique_ptr<LoopShard>> shards_;  // 每个IO loop一个, start()时创建
   std::shared_ptr<EventLoopThreadPool> threadPool_; // eventloopthread线程池
 
   // 回调函数, 对应于TcpConnection, 注册到Channel
@@ -80,8 +144,7 @@ class TcpServer : noncopyable
   ThreadInitCallback threadInitCallback_;
   AtomicInt32 started_;
 
-  int nextConnId_;  // 下一个连接
-  ConnectionMap connections_;   // map维护的connections, 包含若干TcpConnection
+  uint64_t nextConnId_;  // 下一个连接, 只在主loop中使用; kReusePortPerLoop模式下由各shard分配
 };
 
 }  // namespace net
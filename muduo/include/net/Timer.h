@@ -10,20 +10,32 @@ namespace muduo
 namespace net
 {
 
+class TimingWheel;
+
 ///
 /// Internal class for timer event.
-/// 定时事件对象
+/// 定时事件对象, 由TimerQueue池化复用, 同时是时间轮槽中侵入式链表的节点
 class Timer : noncopyable 
 {
  public:
   Timer(TimerCallback cb, Timestamp when, double interval)
     : callback_(std::move(cb)),
-      expiration_(interval),
+      expiration_(when),
       interval_(interval),
       repeat_(interval > 0.0),
-      sequence_(s_numCreated_.incrementAndGet())  //s_numCreated_++作为sequence序号+1
+      canceled_(false),
+      sequence_(s_numCreated_.incrementAndGet()),  //s_numCreated_++作为sequence序号+1
+      tick_(0),
+      prev_(NULL),
+      next_(NULL),
+      slot_(NULL)
   { }
 
+  /// 从池中取出复用, 分配新的sequence, 旧的TimerId因此失效
+  void reset(TimerCallback cb, Timestamp when, double interval);
+  /// 放回池中前释放回调持有的资源
+  void clear() { callback_ = TimerCallback(); }
+
   void run() const {
     callback_();  // 运行回调函数(定时任务)
   }
@@ -31,17 +43,29 @@ class Timer : noncopyable
   Timestamp expiration() const { return expiration_; }
   bool repeat() const { return repeat_; }
   int64_t sequence() const { return sequence_; }
+  bool canceled() const { return canceled_; }
+  void cancel() { canceled_ = true; }  // 回调执行期间被取消, 不再重复
+  bool inWheel() const { return slot_ != NULL; }
 
   void restart(Timestamp now);
 
   static int64_t numCreated() { return s_numCreated_.get(); }
     
  private:
-  const TimerCallback callback_;  // 定时回调函数 typedef std::function<void()> TimerCallback
+  friend class TimingWheel;
+
+  TimerCallback callback_;  // 定时回调函数 typedef std::function<void()> TimerCallback
   Timestamp expiration_;  // 超时时间戳(时刻)
-  const double interval_; // 定时间隔, 如果是0表示不重复
-  const bool repeat_; // 是否重复
-  const int64_t sequence_;  // 编号seq
+  double interval_; // 定时间隔, 如果是0表示不重复
+  bool repeat_; // 是否重复
+  bool canceled_;
+  int64_t sequence_;  // 编号seq
+
+  // 以下由TimingWheel维护
+  int64_t tick_;  // 到期的tick
+  Timer* prev_;
+  Timer* next_;
+  Timer** slot_;  // 所在槽的链表头, NULL表示不在时间轮中
 
   static AtomicInt64 s_numCreated_; // 静态原子变量， 作为全局序号变量
 };
@@ -32,6 +32,12 @@ class Acceptor : noncopyable
     return listening_;
   }
 
+  /// 见Socket::attachReusePortCpuFilter, 对整个SO_REUSEPORT组生效, 在组内任一socket上调用一次即可
+  bool attachReusePortCpuFilter(int groupSize)
+  { return acceptSocket_.attachReusePortCpuFilter(groupSize); }
+  bool attachReusePortCpuFilter(const std::vector<int>& loopCpus)
+  { return acceptSocket_.attachReusePortCpuFilter(loopCpus); }
+
  private:
   void handleRead();
 
@@ -65,17 +65,29 @@ class Buffer : public muduo::copyable
   // 在可读区域找CR LR \r\n, http报文不同段的分隔符
   const char* findCRLF() const
   {
-    const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF+2);
-    return crlf == beginWrite() ? NULL : crlf;
+    return findCRLF(peek());
   }
 
   const char* findCRLF(const char* start) const
   {
     assert(peek() <= start);
     assert(start <= beginWrite());
-    /// std::search 序列[first1，last1)中搜索由[first2，last2)定义的子序列的第一个匹配项
-    const char* crlf = std::search(start, beginWrite(), kCRLF, kCRLF+2);
-    return crlf == beginWrite() ? NULL : crlf;
+    /// memchr找'\r'再看下一个字节, glibc的memchr按CPU用SSE2/AVX2一次比较16/32字节, 比std::search逐字节快
+    const char* end = beginWrite();
+    while (start < end)
+    {
+      const char* cr = static_cast<const char*>(memchr(start, '\r', static_cast<size_t>(end - start)));
+      if (cr == NULL || cr + 1 == end)
+      {
+        return NULL;
+      }
+      if (cr[1] == '\n')
+      {
+        return cr;
+      }
+      start = cr + 1;
+    }
+    return NULL;
   }
   // 寻找\n符号
   const char* findEOL() const
@@ -0,0 +1,124 @@
+#include "muduo/net/BufferPool.h"
+
+#include "muduo/base/CurrentThread.h"
+#include "muduo/net/ChainBuffer.h"
+
+#include <assert.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t BufferPool::kShellCapacity;
+
+namespace
+{
+const size_t kDefaultMaxBufferSize = 128 * 1024;
+const size_t kDefaultMaxFreeBytes = 8 * 1024 * 1024;
+}
+
+BufferPool::BufferPool()
+  : threadId_(CurrentThread::tid()),
+    maxBufferSize_(kDefaultMaxBufferSize),
+    maxFreeBytes_(kDefaultMaxFreeBytes),
+    recycle_(true),
+    freeBytes_(0),
+    freeBuffers_(0),
+    buffersFree_(0),
+    bufferBytesFree_(0),
+    buffersRecycled_(0),
+    bufferBytesShrunk_(0),
+    slabsInUse_(0),
+    slabsFree_(0)
+{
+}
+
+BufferPool::~BufferPool()
+{
+  assert(slabsInUse_.load() == 0);
+  for (char* slab : slabs_)
+  {
+    delete[] slab;
+  }
+}
+
+void BufferPool::acquire(Buffer* buf)
+{
+  if (freeBuffers_ == 0 || buf->readableBytes() != 0 || !isShell(*buf))
+  {
+    return;
+  }
+  Buffer& pooled = buffers_[--freeBuffers_];
+  size_t capacity = pooled.internalCapacity();
+  pooled.swap(*buf);  // buffers_[freeBuffers_]换成了空壳
+  freeBytes_ -= capacity;
+  add(&buffersFree_, -1);
+  add(&bufferBytesFree_, -static_cast<int64_t>(capacity));
+}
+
+void BufferPool::release(Buffer* buf)
+{
+  if (!recycle_ || buf->readableBytes() != 0 || isShell(*buf))
+  {
+    return;
+  }
+  size_t capacity = buf->internalCapacity();
+  add(&buffersRecycled_, 1);
+  if (freeBuffers_ == buffers_.size())
+  {
+    buffers_.push_back(Buffer(0));
+  }
+  Buffer& slot = buffers_[freeBuffers_];
+  slot.swap(*buf);  // buf换成空壳
+  if (capacity > maxBufferSize_ || freeBytes_ + capacity > maxFreeBytes_)
+  {
+    // 收缩: 释放存储, 槽位留作空壳
+    Buffer(0).swap(slot);
+    add(&bufferBytesShrunk_, static_cast<int64_t>(capacity));
+    return;
+  }
+  slot.retrieveAll();
+  ++freeBuffers_;
+  freeBytes_ += capacity;
+  add(&buffersFree_, 1);
+  add(&bufferBytesFree_, static_cast<int64_t>(capacity));
+}
+
+char* BufferPool::allocSlab()
+{
+  slabsInUse_.fetch_add(1, std::memory_order_relaxed);
+  if (slabs_.empty())
+  {
+    return new char[ChainBuffer::kSlabSize];
+  }
+  char* slab = slabs_.back();
+  slabs_.pop_back();
+  freeBytes_ -= ChainBuffer::kSlabSize;
+  add(&slabsFree_, -1);
+  return slab;
+}
+
+void BufferPool::freeSlab(char* slab)
+{
+  slabsInUse_.fetch_sub(1, std::memory_order_relaxed);
+  // 别的线程不能动slabs_和freeBytes_, 还给堆
+  if (CurrentThread::tid() != threadId_ || freeBytes_ + ChainBuffer::kSlabSize > maxFreeBytes_)
+  {
+    delete[] slab;
+    return;
+  }
+  slabs_.push_back(slab);
+  freeBytes_ += ChainBuffer::kSlabSize;
+  add(&slabsFree_, 1);
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+  Stats stats;
+  stats.buffersFree = buffersFree_.load(std::memory_order_relaxed);
+  stats.bufferBytesFree = bufferBytesFree_.load(std::memory_order_relaxed);
+  stats.buffersRecycled = buffersRecycled_.load(std::memory_order_relaxed);
+  stats.bufferBytesShrunk = bufferBytesShrunk_.load(std::memory_order_relaxed);
+  stats.slabsInUse = slabsInUse_.load(std::memory_order_relaxed);
+  stats.slabsFree = slabsFree_.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,99 @@
+#ifndef MUDUO_NET_BUFFERPOOL_H_
+#define MUDUO_NET_BUFFERPOOL_H_
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/net/Buffer.h"
+
+#include <atomic>
+#include <vector>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace muduo
+{
+namespace net
+{
+
+/// 每个EventLoop一个的缓冲区池, 只在所属loop线程中使用(stats()和freeSlab()除外)。
+///
+/// 连接不再永久占有自己的缓冲区: 读之前从池中借一块Buffer存储, 数据处理完(可读为空)就还回来,
+/// ChainBuffer的slab也从这里分配、写完归还。大量空闲的keep-alive连接因此几乎不占缓冲区内存,
+/// 活跃连接之间复用同一批存储。
+///
+/// 收缩策略: 超过maxBufferSize的存储(比如为一个大请求扩张过的)归还时直接释放;
+/// 池中空闲存储总量超过maxFreeBytes时, 多出来的也直接释放。
+class BufferPool : noncopyable
+{
+ public:
+  struct Stats
+  {
+    int64_t buffersFree;  // 池中空闲的Buffer存储
+    int64_t bufferBytesFree;  // 空闲Buffer存储的总容量
+    int64_t buffersRecycled;  // 累计归还(包括被收缩释放的)次数
+    int64_t bufferBytesShrunk;  // 累计因收缩策略释放的字节数
+    int64_t slabsInUse;  // ChainBuffer正在使用的slab
+    int64_t slabsFree;  // 池中空闲的slab
+  };
+
+  BufferPool();
+  ~BufferPool();
+
+  /// buf没有可用存储(空壳)时从池中换一块进来; 池空时保持不变, 读的时候再按需分配
+  void acquire(Buffer* buf);
+
+  /// buf中的数据已经处理完: 把存储还给池(或按收缩策略释放), buf只剩一个几乎不占内存的空壳
+  void release(Buffer* buf);
+
+  /// ChainBuffer::kSlabSize字节的slab
+  char* allocSlab();
+  /// 任意线程可调用: 最后一个TcpConnectionPtr可能在别的线程释放, 连接的ChainBuffer随之析构。
+  /// 不在所属线程时直接delete, 不碰空闲列表
+  void freeSlab(char* slab);
+
+  void setMaxBufferSize(size_t bytes)
+  { maxBufferSize_ = bytes; }
+
+  void setMaxFreeBytes(size_t bytes)
+  { maxFreeBytes_ = bytes; }
+
+  /// 关闭后release()什么也不做, 连接一直占着自己扩张过的缓冲区(原来的行为)
+  void setRecycle(bool on)
+  { recycle_ = on; }
+
+  /// 任意线程可调用, 各项之间不保证是同一时刻的值
+  Stats stats() const;
+
+ private:
+  static const size_t kShellCapacity = Buffer::kCheapPrepend;  // 空壳Buffer(0)的容量
+
+  static bool isShell(const Buffer& buf)
+  { return buf.internalCapacity() <= kShellCapacity; }
+
+  /// 只有loop线程写, 其他线程读
+  static void add(std::atomic<int64_t>* counter, int64_t delta)
+  { counter->store(counter->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed); }
+
+  const pid_t threadId_;  // 所属loop线程, 构造时的线程
+  size_t maxBufferSize_;
+  size_t maxFreeBytes_;
+  bool recycle_;
+  size_t freeBytes_;  // 空闲Buffer存储加上空闲slab的总字节数
+
+  // [0, freeBuffers_)是有存储的空闲Buffer, 之后是换回来的空壳, 留着下次release()用, 稳定后不再分配
+  std::vector<Buffer> buffers_;
+  size_t freeBuffers_;
+  std::vector<char*> slabs_;
+
+  std::atomic<int64_t> buffersFree_;
+  std::atomic<int64_t> bufferBytesFree_;
+  std::atomic<int64_t> buffersRecycled_;
+  std::atomic<int64_t> bufferBytesShrunk_;
+  std::atomic<int64_t> slabsInUse_;  // 别的线程也会减, 用fetch_add/fetch_sub
+  std::atomic<int64_t> slabsFree_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_BUFFERPOOL_H_
@@ -0,0 +1,317 @@
+#include "muduo/net/ChainBuffer.h"
+
+#include "muduo/net/Buffer.h"
+#include "muduo/net/BufferPool.h"
+#include "muduo/net/SocketsOps.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const size_t ChainBuffer::kSlabSize;
+const size_t ChainBuffer::kMinSliceSize;
+const int ChainBuffer::kMaxIovec;
+
+ChainBuffer::ChainBuffer(BufferPool* pool)
+  : pool_(pool),
+    readableBytes_(0),
+    zeroCopyFirstSeq_(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+  retrieveAll();
+}
+
+void ChainBuffer::swap(ChainBuffer& rhs)
+{
+  std::swap(pool_, rhs.pool_);
+  segments_.swap(rhs.segments_);
+  std::swap(readableBytes_, rhs.readableBytes_);
+  zeroCopyPinned_.swap(rhs.zeroCopyPinned_);
+  std::swap(zeroCopyFirstSeq_, rhs.zeroCopyFirstSeq_);
+}
+
+void ChainBuffer::append(const char* data, size_t len)
+{
+  while (len > 0)
+  {
+    size_t writable = tailWritable();
+    if (writable == 0)
+    {
+      appendSlab();
+      writable = kSlabSize;
+    }
+    Segment& tail = segments_.back();
+    size_t n = std::min(len, writable);
+    ::memcpy(tail.slab + (tail.data - tail.slab) + tail.size, data, n);  // 只写尾部空闲区, 已有数据原地不动
+    tail.size += n;
+    readableBytes_ += n;
+    data += n;
+    len -= n;
+  }
+}
+
+void ChainBuffer::append(Buffer* buf)
+{
+  size_t len = buf->readableBytes();
+  if (len < kMinSliceSize)
+  {
+    append(buf->peek(), len);
+    buf->retrieveAll();
+    return;
+  }
+  // 把buf的存储换到一个共享的Buffer里挂到链上, buf本身变为空
+  std::shared_ptr<Buffer> holder(new Buffer(0));
+  holder->swap(*buf);
+  appendSlice(holder, holder->peek(), len);
+}
+
+void ChainBuffer::append(ChainBuffer* chain)
+{
+  assert(chain != this && chain->zeroCopyPending() == 0);
+  for (Segment& seg : chain->segments_)
+  {
+    segments_.push_back(std::move(seg));
+  }
+  readableBytes_ += chain->readableBytes_;
+  chain->segments_.clear();
+  chain->readableBytes_ = 0;
+}
+
+void ChainBuffer::appendSlice(const std::shared_ptr<const void>& owner, const char* data, size_t len)
+{
+  if (len < kMinSliceSize)
+  {
+    append(data, len);
+    return;
+  }
+  Segment seg;
+  seg.slab = NULL;
+  seg.pool = NULL;
+  seg.owner = owner;
+  seg.data = data;
+  seg.size = len;
+  seg.fd = -1;
+  seg.offset = 0;
+  segments_.push_back(std::move(seg));
+  readableBytes_ += len;
+}
+
+void ChainBuffer::appendFile(int fd, off_t offset, size_t len)
+{
+  if (len == 0)
+  {
+    ::close(fd);
+    return;
+  }
+  Segment seg;
+  seg.slab = NULL;
+  seg.pool = NULL;
+  seg.data = NULL;
+  seg.size = len;
+  seg.fd = fd;
+  seg.offset = offset;
+  segments_.push_back(std::move(seg));
+  readableBytes_ += len;
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+  assert(len <= readableBytes_);
+  while (len > 0)
+  {
+    Segment& front = segments_.front();
+    if (len < front.size)
+    {
+      if (front.fd >= 0)
+      {
+        front.offset += static_cast<off_t>(len);
+      }
+      else
+      {
+        front.data += len;
+      }
+      front.size -= len;
+      readableBytes_ -= len;
+      break;
+    }
+    len -= front.size;
+    readableBytes_ -= front.size;
+    releaseFront();
+  }
+}
+
+void ChainBuffer::retrieveAll()
+{
+  while (!segments_.empty())
+  {
+    releaseFront();
+  }
+  readableBytes_ = 0;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int* savedErrno, size_t zeroCopyThreshold)
+{
+  if (!segments_.empty() && segments_.front().fd >= 0)
+  {
+    return sendFileFront(fd, savedErrno);
+  }
+  if (zeroCopyThreshold > 0 && !segments_.empty()
+      && segments_.front().owner && segments_.front().size >= zeroCopyThreshold)
+  {
+    return sendZeroCopyFront(fd, savedErrno);
+  }
+  // 收集文件段以及需要零拷贝的段之前的内存段
+  struct iovec vec[kMaxIovec];
+  int iovcnt = 0;
+  for (std::deque<Segment>::const_iterator it = segments_.begin();
+       it != segments_.end() && it->fd < 0 && iovcnt < kMaxIovec;
+       ++it)
+  {
+    if (zeroCopyThreshold > 0 && iovcnt > 0 && it->owner && it->size >= zeroCopyThreshold)
+    {
+      break;
+    }
+    vec[iovcnt].iov_base = const_cast<char*>(it->data);
+    vec[iovcnt].iov_len = it->size;
+    ++iovcnt;
+  }
+  const ssize_t n = sockets::writev(fd, vec, iovcnt);
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else
+  {
+    retrieve(static_cast<size_t>(n));
+  }
+  return n;
+}
+
+int ChainBuffer::peekMemory(struct iovec* vec, int maxIovec) const
+{
+  int iovcnt = 0;
+  for (std::deque<Segment>::const_iterator it = segments_.begin();
+       it != segments_.end() && it->fd < 0 && iovcnt < maxIovec;
+       ++it)
+  {
+    vec[iovcnt].iov_base = const_cast<char*>(it->data);
+    vec[iovcnt].iov_len = it->size;
+    ++iovcnt;
+  }
+  return iovcnt;
+}
+
+ssize_t ChainBuffer::sendFileFront(int fd, int* savedErrno)
+{
+  Segment& front = segments_.front();
+  off_t offset = front.offset;
+  const ssize_t n = sockets::sendfile(fd, front.fd, &offset, front.size);
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else if (n == 0)
+  {
+    *savedErrno = EIO;  // 文件被截断, 再等可写事件也不会有进展
+    return -1;
+  }
+  else
+  {
+    retrieve(static_cast<size_t>(n));
+  }
+  return n;
+}
+
+ssize_t ChainBuffer::sendZeroCopyFront(int fd, int* savedErrno)
+{
+  Segment& front = segments_.front();
+  const ssize_t n = sockets::sendZeroCopy(fd, front.data, front.size);
+  if (n < 0)
+  {
+    *savedErrno = errno;
+  }
+  else if (n > 0)
+  {
+    // 每次成功的发送在内核中占一个序号, 完成通知按序号区间确认; 在那之前保留数据的所有者
+    Pinned pinned;
+    pinned.owner = front.owner;
+    pinned.done = false;
+    zeroCopyPinned_.push_back(std::move(pinned));
+    retrieve(static_cast<size_t>(n));
+  }
+  return n;
+}
+
+void ChainBuffer::releaseZeroCopy(uint32_t lo, uint32_t hi)
+{
+  uint32_t seq = lo;
+  while (true)  // 序号是32位回绕的, 不能用seq <= hi
+  {
+    uint32_t index = seq - zeroCopyFirstSeq_;
+    if (index < zeroCopyPinned_.size())
+    {
+      zeroCopyPinned_[index].done = true;
+      zeroCopyPinned_[index].owner.reset();
+    }
+    if (seq == hi)
+    {
+      break;
+    }
+    ++seq;
+  }
+  while (!zeroCopyPinned_.empty() && zeroCopyPinned_.front().done)
+  {
+    zeroCopyPinned_.pop_front();
+    ++zeroCopyFirstSeq_;
+  }
+}
+
+size_t ChainBuffer::tailWritable() const
+{
+  if (segments_.empty() || segments_.back().slab == NULL)
+  {
+    return 0;
+  }
+  const Segment& tail = segments_.back();
+  return kSlabSize - static_cast<size_t>(tail.data - tail.slab) - tail.size;
+}
+
+void ChainBuffer::appendSlab()
+{
+  Segment seg;
+  seg.slab = pool_ ? pool_->allocSlab() : new char[kSlabSize];
+  seg.pool = pool_;
+  seg.data = seg.slab;
+  seg.size = 0;
+  seg.fd = -1;
+  seg.offset = 0;
+  segments_.push_back(std::move(seg));
+}
+
+void ChainBuffer::releaseFront()
+{
+  Segment& front = segments_.front();
+  if (front.fd >= 0)
+  {
+    ::close(front.fd);
+  }
+  if (front.slab && front.pool)
+  {
+    front.pool->freeSlab(front.slab);
+  }
+  else
+  {
+    delete[] front.slab;
+  }
+  segments_.pop_front();
+}
@@ -0,0 +1,139 @@
+#ifndef MUDUO_NET_CHAINBUFFER_H_
+#define MUDUO_NET_CHAINBUFFER_H_
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/StringPiece.h"
+#include "muduo/base/Types.h"
+
+#include <deque>
+#include <memory>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+struct iovec;
+
+namespace muduo
+{
+namespace net
+{
+
+class Buffer;
+class BufferPool;
+
+/// A chained output buffer made of fixed-size slabs, refcounted external slices
+/// and file regions.
+///
+/// @code
+/// +--------------+    +-----------------+    +--------------+    +--------------+
+/// | slab 16KiB   | -> | external slice  | -> | slab 16KiB   | -> | file region  |
+/// | [read..len)  |    | (shared_ptr)    |    | [0..len) ... |    | fd, offset   |
+/// +--------------+    +-----------------+    +--------------+    +--------------+
+/// @endcode
+///
+/// 与Buffer不同, 追加数据从不移动已排队的数据: 写满一个slab就再挂一个新的(只有最后一个slab的尾部可写),
+/// 外部数据(大块字符串, 整个Buffer)只增加引用计数挂到链上, 不拷贝。
+/// writeFd()用一次writev把多个内存段写出, 遇到文件段则用sendfile(2)在内核中发送。
+/// 只在所属loop线程中使用; 不带pool的ChainBuffer可以在其他线程中填充(由调用者加锁), 再整体转移过来。
+class ChainBuffer : noncopyable
+{
+ public:
+  static const size_t kSlabSize = 16 * 1024;
+  static const size_t kMinSliceSize = 4096;  // 小于这个的外部数据直接拷贝进slab, 省去一个段
+  static const int kMaxIovec = 64;  // 一次writev最多写出的段数
+
+  /// pool非空时slab从pool借、写完还回去, 否则直接new/delete
+  explicit ChainBuffer(BufferPool* pool = NULL);
+  ~ChainBuffer();
+
+  void swap(ChainBuffer& rhs);
+
+  size_t readableBytes() const
+  { return readableBytes_; }
+
+  size_t segmentCount() const
+  { return segments_.size(); }
+
+  /// 拷贝到尾部slab中, 不够时追加新的slab
+  void append(const char* data, size_t len);
+
+  void append(const void* data, size_t len)
+  { append(static_cast<const char*>(data), len); }
+
+  void append(const StringPiece& str)
+  { append(str.data(), str.size()); }
+
+  /// 取走buf中全部可读数据: 小块拷贝, 大块把buf的存储整体挂到链上, 不拷贝
+  void append(Buffer* buf);
+
+  /// 取走chain中的全部数据, 所有段(包括slab)直接转移, 不拷贝。chain不能有未确认的MSG_ZEROCOPY发送
+  void append(ChainBuffer* chain);
+
+  /// 挂上一段外部数据, owner保证data在写出之前一直有效
+  void appendSlice(const std::shared_ptr<const void>& owner, const char* data, size_t len);
+
+  void appendSlice(const std::shared_ptr<const string>& str)
+  { appendSlice(str, str->data(), str->size()); }
+
+  /// 挂上文件区域[offset, offset+len), 取得fd的所有权, 发送完或丢弃时close
+  void appendFile(int fd, off_t offset, size_t len);
+
+  /// 丢弃前len个字节, 释放已经写完的段
+  void retrieve(size_t len);
+
+  void retrieveAll();
+
+  /// 用writev(或sendfile)写出尽可能多的数据并retrieve, 返回值与::writev相同。
+  /// 文件比登记的长度短时返回-1, *savedErrno为EIO。
+  /// zeroCopyThreshold非0时, 不小于它的外部数据段用MSG_ZEROCOPY发送, 其所有者转入待确认列表,
+  /// 直到releaseZeroCopy()确认内核不再引用
+  ssize_t writeFd(int fd, int* savedErrno, size_t zeroCopyThreshold = 0);
+
+  /// 开头连续的内存段(到第一个文件段为止, 最多maxIovec段)填进vec, 返回段数, 不取走数据。
+  /// 异步写用: 写完成之前这些段不能retrieve; 之后追加的数据不影响它们
+  int peekMemory(struct iovec* vec, int maxIovec) const;
+
+  /// 错误队列中的完成通知: 第[lo, hi]次MSG_ZEROCOPY发送已完成
+  void releaseZeroCopy(uint32_t lo, uint32_t hi);
+
+  /// 还在等待内核完成通知的MSG_ZEROCOPY发送次数
+  size_t zeroCopyPending() const
+  { return zeroCopyPinned_.size(); }
+
+ private:
+  struct Segment
+  {
+    char* slab;  // 自有的slab, 外部数据时为NULL
+    BufferPool* pool;  // slab的来源, NULL表示new出来的; 转移到别的链上也还回原来的pool
+    std::shared_ptr<const void> owner;  // 外部数据的所有者, slab时为空
+    const char* data;  // 可读数据的起点, 文件段为NULL
+    size_t size;  // 可读字节数
+    int fd;  // 文件段的fd, 内存段为-1
+    off_t offset;  // 文件段下一个要发送的位置
+  };
+
+  /// 尾部slab还能写多少字节
+  size_t tailWritable() const;
+  void appendSlab();
+  ssize_t sendFileFront(int fd, int* savedErrno);
+  ssize_t sendZeroCopyFront(int fd, int* savedErrno);
+  void releaseFront();
+
+  /// 一次MSG_ZEROCOPY发送引用的数据, 按发送序号排列
+  struct Pinned
+  {
+    std::shared_ptr<const void> owner;
+    bool done;
+  };
+
+  BufferPool* pool_;
+  std::deque<Segment> segments_;
+  size_t readableBytes_;
+  std::deque<Pinned> zeroCopyPinned_;
+  uint32_t zeroCopyFirstSeq_;  // zeroCopyPinned_.front()的发送序号, 与内核的计数一致
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_CHAINBUFFER_H_
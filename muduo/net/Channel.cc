@@ -17,9 +17,16 @@ Channel::Channel(EventLoop* loop, int fd__) // 构造函数, 构造所属loop_
   : loop_(loop),
     fd_(fd__),
     events_(0),
+    pollEvents_(0),
     revents_(0),
     index_(-1),
     logHup_(true),
+    edgeTriggered_(false),
+    asyncIo_(false),
+    asyncWriteDone_(false),
+    asyncReadResult_(0),
+    asyncWriteResult_(0),
+    asyncReadData_(NULL),
     tied_(false),
     eventHandling_(false),
     addedToLoop_(false)
@@ -44,6 +51,16 @@ void Channel::tie(const std::shared_ptr<void>& obj) // Channel地weak_ptr绑定T
 
 void Channel::update() // 向poll更新event(即channel)
 {
+  int pollEvents = events_;
+  if (edgeTriggered_ && events_ != kNoneEvent)
+  {
+    pollEvents |= kWriteEvent;  // 边沿触发时可写事件常驻, 只在读事件开关或者全部关闭时才需要epoll_ctl
+  }
+  if (edgeTriggered_ && addedToLoop_ && pollEvents == pollEvents_)
+  {
+    return;
+  }
+  pollEvents_ = pollEvents;
   addedToLoop_ = true;
   loop_->updateChannel(this); // 实际调用poll
 }
@@ -98,7 +115,7 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) // channel活跃之后
   {
     if (readCallback_) readCallback_(receiveTime);
   }
-  if (revents_ & POLLOUT) // 可写回调
+  if ((revents_ & POLLOUT) && (!edgeTriggered_ || isWriting())) // 可写回调, 边沿触发时没有待写数据就忽略
   {
     if (writeCallback_) writeCallback_();
   }
@@ -7,7 +7,7 @@
 #include <algorithm>
 
 #include "muduo/base/Logging.h"
-#include "muduo/base/Mutex.h"
+#include "muduo/net/BufferPool.h"
 #include "muduo/net/Channel.h"
 #include "muduo/net/Poller.h"
 #include "muduo/net/SocketsOps.h"
@@ -65,9 +65,15 @@ EventLoop::EventLoop()
     threadId_(CurrentThread::tid()),  // 创建eventloop对象的子线程(eventloop为线程栈对象), eventLoop在子线程的线程池中就已经创建
     poller_(Poller::newDefaultPoller(this)),  // 用loop*创建pooler, 是pool存在用unique_ptr维护的指针
     timerQueue_(new TimerQueue(this)),  // 通过loop*创建timerQueue, 赋给timerQueue_指针
+    bufferPool_(new BufferPool),
     wakeupFd_(createEventfd()), // 创建wakeupFd_
     wakeupChannel_(new Channel(this, wakeupFd_)), // 基于loop* 和wakeupFd创建wakeup通道
-    currentActiveChannel_(NULL) // poll之后的活跃通道
+    currentActiveChannel_(NULL), // poll之后的活跃通道
+    wakeupPending_(false),
+    busyPollMaxUs_(0),
+    busyPollBudgetUs_(0),
+    avgWaitUs_(0),
+    connectionCount_(0)
 {
   LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
   if (t_loopInThisThread) // 线程中存在loop指针(构造eventloop线程不应该持有loop指针)
@@ -102,11 +108,17 @@ void EventLoop::loop()  // 主要函数, 线程内部线程栈有eventloop对象
   quit_ = false;
   LOG_TRACE << "EventLoop " << this << " start looping";
 
+  // 每段的结束时刻就是下一段的开始, 每轮只多读1 + 活跃channel数次单调时钟
+  int64_t lastUs = Timestamp::monotonicNow().microSecondsSinceEpoch();
   while (!quit_)  // 只要quit不为true就循环
   {
 
     activeChannels_.clear();  // 先清空std::vector<Channel*> ChannelList 活跃channel
-    pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);  // 线程一般会阻塞在poll中, 内部是epoll_wait, 等待触发的事件, 返回的触发事件列表
+    pollReturnTime_ = pollOnce();  // 线程一般会阻塞在poll中, 内部是epoll_wait, 等待触发的事件, 返回的触发事件列表
+    ++iteration_;
+    int64_t nowUs = Timestamp::monotonicNow().microSecondsSinceEpoch();
+    stats_.recordPoll(nowUs - lastUs, activeChannels_.size());
+    lastUs = nowUs;
     /// 打印活跃的channel
     if (Logger::logLevel() <= Logger::TRACE)  // 打印活跃的channel
     {
@@ -118,17 +130,71 @@ void EventLoop::loop()  // 主要函数, 线程内部线程栈有eventloop对象
       currentActiveChannel_ = channel;
       /// 处理handleEvent函数
       currentActiveChannel_->handleEvent(pollReturnTime_); // 调用channel的handleEvent函数, 实际上根据poll的事件类型调用channel的回调函数。回调函数包括应用层逻辑
+      nowUs = Timestamp::monotonicNow().microSecondsSinceEpoch();
+      stats_.recordHandler(nowUs - lastUs, channel->fd());
+      lastUs = nowUs;
     }
     // 清空ActiveChannel_
     currentActiveChannel_ = NULL;
     eventHandling_ = false;
 
     /// 待执行的任务队列
-    doPendingFunctors();  // 执行需要该线程执行的任务队列, 包括Tcp连接建立&TcpConnection::connectEstablished, 定时器任务等
+    size_t functors = doPendingFunctors();  // 执行需要该线程执行的任务队列, 包括Tcp连接建立&TcpConnection::connectEstablished, 定时器任务等
+    functors += doIterationEndFunctors();  // 一轮结束, 比如把本轮各连接cork住的输出各用一次writev写出
+    nowUs = Timestamp::monotonicNow().microSecondsSinceEpoch();
+    stats_.recordFunctors(nowUs - lastUs, functors);
+    lastUs = nowUs;
   }
 
   LOG_TRACE << "EventLoop " << this << " stop looping";
   looping_ = false;
+  pollReturnTime_ = Timestamp::invalid();  // loop()返回后cachedNow()不再返回过时的时间
+}
+
+Timestamp EventLoop::cachedNow()
+{
+  EventLoop* loop = t_loopInThisThread;
+  if (loop && loop->pollReturnTime_.valid())
+  {
+    return loop->pollReturnTime_;
+  }
+  return Timestamp::now();
+}
+
+Timestamp EventLoop::pollOnce()
+{
+  const int maxUs = busyPollMaxUs_.load(std::memory_order_relaxed);
+  if (maxUs <= 0)
+  {
+    return poller_->poll(kPollTimeMs, &activeChannels_);
+  }
+
+  // 空转的截止时间和等待时长用单调时钟, 墙上时钟回拨时不会一直空转, 也不会把平均值带偏;
+  // 返回给调用者的仍是poller的时间戳
+  const int64_t startUs = Timestamp::monotonicNow().microSecondsSinceEpoch();
+  Timestamp now(Timestamp::now());  // 两次poll都没做(quit_)时返回的时间
+  if (busyPollBudgetUs_ > 0)
+  {
+    // 定时器和其他线程的唤醒都是fd, 空转期间同样能发现
+    const int64_t deadline = startUs + busyPollBudgetUs_;
+    do
+    {
+      now = poller_->poll(0, &activeChannels_);
+    } while (activeChannels_.empty() && !quit_
+             && Timestamp::monotonicNow().microSecondsSinceEpoch() < deadline);
+  }
+  if (activeChannels_.empty() && !quit_)
+  {
+    now = poller_->poll(kPollTimeMs, &activeChannels_);
+  }
+
+  // 空转时长取平均等待的2倍, 下一个事件多半在这之内到来; 很久才来一次的就不空转了。
+  // 等待时长截断在4倍上限, 空闲很久之后流量恢复时能很快回到空转
+  int64_t waitedUs = std::min(Timestamp::monotonicNow().microSecondsSinceEpoch() - startUs,
+                              4 * static_cast<int64_t>(maxUs));
+  avgWaitUs_ += (waitedUs - avgWaitUs_) / 8;
+  busyPollBudgetUs_ = 2 * avgWaitUs_ <= maxUs ? 2 * avgWaitUs_ : 0;
+  return now;
 }
 
 void EventLoop::quit() // 退出loop循环, 这个主线程执行
@@ -155,10 +221,7 @@ void EventLoop::runInLoop(Functor cb)
 /// 将任务加入到任务队列中
 void EventLoop::queueInLoop(Functor cb)
 {
-  {
-  MutexLockGuard lock(mutex_);
-  pendingFunctors_.push_back(std::move(cb));  // 多个线程可以将任务加入到同一个线程的pendingFunctors_, 因此需要同步
-  }
+  pendingFunctors_.push(std::move(cb));  // 多个线程可以将任务加入到同一个线程的pendingFunctors_, 无锁队列保证同步
   // 这里还是主线程, 调用wakeup唤醒子线程(阻塞在epollwait呢)
   if (!isInLoopThread() || callingPendingFunctors_) // 执行的不是loop所属线程线程或者, loop线程在执行pendingFunctors(没有阻塞)
   {
@@ -166,26 +229,33 @@ void EventLoop::queueInLoop(Functor cb)
   }
 }
 
+void EventLoop::runAfterIteration(Functor cb)
+{
+  assertInLoopThread();
+  iterationEndFunctors_.push_back(std::move(cb));
+}
+
 size_t EventLoop::queueSize() const
 {
-  MutexLockGuard lock(mutex_);
-  return pendingFunctors_.size(); // 等待队列的大小, 要加锁, 有可能别人在写
+  return pendingFunctors_.size(); // 等待队列的大小, 原子计数, 不需要加锁
 }
 
 TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 {
-  return timerQueue_->addTimer(std::move(cb), time, 0.0); // 将cb, time, 0.0表示在time时刻执行cb的定时
+  // 墙上时间换算成单调时钟的时刻
+  double delay = timeDifference(time, Timestamp::now());
+  return runAfter(delay, std::move(cb));
 }
 
 TimerId EventLoop::runAfter(double delay, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), delay)); // 设置时间戳未time+delay
-  return runAt(time, std::move(cb));  // 加入定时器
+  Timestamp time(addTime(Timestamp::monotonicNow(), delay)); // 设置时间戳未time+delay
+  return timerQueue_->addTimer(std::move(cb), time, 0.0); // 将cb, time, 0.0表示在time时刻执行cb的定时
 }
 
 TimerId EventLoop::runEvery(double interval, TimerCallback cb)
 {
-  Timestamp time(addTime(Timestamp::now(), interval));
+  Timestamp time(addTime(Timestamp::monotonicNow(), interval));
   return timerQueue_->addTimer(std::move(cb), time, interval);  // 有间隔的时间戳加入定时器
 }
 
@@ -222,6 +292,37 @@ bool EventLoop::hasChannel(Channel* channel)  // has_channel, 调用poller_判
   return poller_->hasChannel(channel);
 }
 
+bool EventLoop::supportsEdgeTriggered() const
+{
+  return poller_->supportsEdgeTriggered();
+}
+
+bool EventLoop::supportsAsyncIo() const
+{
+  return poller_->supportsAsyncIo();
+}
+
+void EventLoop::asyncRead(Channel* channel)
+{
+  assert(channel->ownerLoop() == this);
+  assertInLoopThread();
+  poller_->asyncRead(channel);
+}
+
+void EventLoop::asyncWrite(Channel* channel, const struct iovec* iov, int iovcnt)
+{
+  assert(channel->ownerLoop() == this);
+  assertInLoopThread();
+  poller_->asyncWrite(channel, iov, iovcnt);
+}
+
+void EventLoop::cancelAsyncIo(Channel* channel, bool read, bool write)
+{
+  assert(channel->ownerLoop() == this);
+  assertInLoopThread();
+  poller_->cancelAsyncIo(channel, read, write);
+}
+
 /// 非loop线程执行, 抛弃此次执行
 void EventLoop::abortNotInLoopThread()
 {
@@ -232,6 +333,10 @@ void EventLoop::abortNotInLoopThread()
 
 void EventLoop::wakeup()  // 发送一个写操作, 以触发wakeupFd_的可读事件。解除loop阻塞在epoll_wait。
 {
+  if (wakeupPending_.exchange(true))  // 已经有人唤醒过且loop还没处理任务队列, 省掉一次write系统调用
+  {
+    return;
+  }
   uint64_t one = 1;
   /// 这里是主线程调用, 但wakeupFd_却是子线程的, 结果就是主线程调sockets::write(wakeupFd_, 被对应子线程的poller接收, 起到了唤醒的作用
   ssize_t n = sockets::write(wakeupFd_, &one, sizeof one);
@@ -251,23 +356,35 @@ void EventLoop::handleRead()  // 读wakeupFd_回调
   }
 }
 
-void EventLoop::doPendingFunctors() // 运行等待队列的函数
+size_t EventLoop::doPendingFunctors() // 运行等待队列的函数
 {
-  /// 新建一个functor
-  std::vector<Functor> functors;
   callingPendingFunctors_ = true;
-  /// CAS操作， 有可能线程正在执行pendingFunctors_, 因此需要CAS防止竞态
-  {
-  MutexLockGuard lock(mutex_);
-  functors.swap(pendingFunctors_);
-  }
+  /// 先清除唤醒标志再取任务: 之后入队的生产者会重新wakeup, 不会丢失唤醒
+  wakeupPending_.store(false);
 
-  /// 全部执行完
-  for (const Functor& functor : functors)
+  /// 批量执行进入本函数时已在队列里的任务(与原先swap语义一致), 执行期间新加入的任务留到下一轮, 避免饿死IO事件
+  size_t n = pendingFunctors_.drain([](const Functor& functor) { functor(); });
+  callingPendingFunctors_ = false;
+  return n;
+}
+
+size_t EventLoop::doIterationEndFunctors()
+{
+  // 和doPendingFunctors一样, 这时queueInLoop加入的任务要等下一轮, 需要wakeup
+  callingPendingFunctors_ = true;
+  size_t n = 0;
+  while (!iterationEndFunctors_.empty())  // 执行中又登记的也在本轮执行
   {
-    functor();
+    runningIterationEndFunctors_.swap(iterationEndFunctors_);
+    for (const Functor& functor : runningIterationEndFunctors_)
+    {
+      functor();
+    }
+    n += runningIterationEndFunctors_.size();
+    runningIterationEndFunctors_.clear();
   }
   callingPendingFunctors_ = false;
+  return n;
 }
 
 /// 打印activeChannels_
@@ -3,21 +3,26 @@
 
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <vector>
 
 #include <boost/any.hpp>
 
-#include "muduo/base/Mutex.h"
 #include "muduo/base/CurrentThread.h"
+#include "muduo/base/MpscQueue.h"
 #include "muduo/base/Timestamp.h"
+#include "muduo/net/LoopStats.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/TimerId.h"
 
+struct iovec;
+
 namespace muduo
 {
 namespace net
 {
 
+class BufferPool;
 class Channel;
 class Poller;
 class TimerQueue;
@@ -51,15 +56,35 @@ class EventLoop : noncopyable
 
   Timestamp pollReturnTime() const { return pollReturnTime_; }  // poll触发返回的时间戳
 
+  /// 当前线程的缓存时钟: 在loop线程中返回本轮poll返回的时刻(每轮刷新一次), 回调里读不需要再取时间;
+  /// 不在loop线程中或者loop还没开始转时返回Timestamp::now()。
+  /// 精度是一轮循环, 适合日志、请求时间戳这类不需要精确到微秒的地方, 比如Logger::setClock(EventLoop::cachedNow)
+  static Timestamp cachedNow();
+
   int64_t iteration() const { return iteration_; }
 
+  /// 本loop的耗时统计(poll等待、回调、任务队列等的直方图), 任意线程可调用, 返回一致的快照
+  LoopStats::Snapshot stats() const { return stats_.snapshot(); }
+
   void runInLoop(Functor cb); // 保证在loop所属线程中执行某函数, 如果在线程立即执行, 如果不在调用queueInLoop
 
   void queueInLoop(Functor cb); // 放入到loop对象的等待队列中并触发loop对象所属线程执行
 
-  size_t queueSize() const;
+  size_t queueSize() const;  // 近似值, 任意线程可调用
+
+  /// 本轮的IO事件和任务队列都处理完之后、下一次poll之前执行cb, 只能在loop线程中调用。
+  /// 用来把一轮中零散的操作合并成一次, 比如TcpConnection的自动cork
+  void runAfterIteration(Functor cb);
+
+  /// 忙轮询: 阻塞等待之前先用poll(0)空转最多maxBudgetUs微秒, 用CPU换延迟。0表示关闭(默认)。
+  /// 实际空转时长按最近的等待时长自适应(平均等待的2倍), 事件间隔超过上限时直接阻塞, 不白白空转。
+  /// 任意线程可调用
+  void setBusyPoll(int maxBudgetUs) { busyPollMaxUs_.store(maxBudgetUs, std::memory_order_relaxed); }
+  int busyPollBudgetUs() const { return static_cast<int>(busyPollBudgetUs_); }  // 当前自适应的空转时长, loop线程中调用
 
   // timers, 设置定时器任务
+  /// 定时器用单调时钟, 修改系统时间不影响。
+  /// runAt的time是墙上时间, 调用时换算成单调时钟的时刻, 之后系统时间跳变它也不跟着变
   TimerId runAt(Timestamp time, TimerCallback cb);  // 某个时刻执行定时任务
   TimerId runAfter(double delay, TimerCallback cb); // 再过某个时间段执行的定时任务
   TimerId runEvery(double interval, TimerCallback cb);  // 设置一个循环定时器
@@ -67,10 +92,22 @@ class EventLoop : noncopyable
 
   // internal usage
   /// 更新channel，就是更新需要poll的连接，因此调用poller内部函数实现
-  void wakeup();
+  void wakeup();  // 已有未处理的唤醒时不再重复写eventfd
   void updateChannel(Channel* channel);
   void removeChannel(Channel* channel);
   bool hasChannel(Channel* channel);
+  bool supportsEdgeTriggered() const;  // poller_是否支持边沿触发, 构造后不变, 可在任意线程调用
+  bool supportsAsyncIo() const;  // poller_是否支持异步读写(io_uring), 同上
+  /// 异步读写, 见Poller::asyncRead()等, 只能在supportsAsyncIo()时调用
+  void asyncRead(Channel* channel);
+  void asyncWrite(Channel* channel, const struct iovec* iov, int iovcnt);
+  void cancelAsyncIo(Channel* channel, bool read, bool write);
+  /// 本loop上连接共用的缓冲区池, 连接持有一份shared_ptr, 可以比loop活得久
+  const std::shared_ptr<BufferPool>& bufferPool() const { return bufferPool_; }
+
+  /// 属于本loop的TcpConnection对象个数, 从构造到connectDestroyed(), 任意线程可读(近似值)
+  int connectionCount() const { return connectionCount_.load(std::memory_order_relaxed); }
+  void addConnectionCount(int delta) { connectionCount_.fetch_add(delta, std::memory_order_relaxed); }
 
   // pid_t threadId() const { return threadId_; }
   void assertInLoopThread()
@@ -100,8 +137,10 @@ class EventLoop : noncopyable
 
   void abortNotInLoopThread();   // EventLoop对象创建者并非本线程
   void handleRead();    // wakefd触发的回调函数
-  void doPendingFunctors();   // 运行等待的任务
+  size_t doPendingFunctors();   // 运行等待的任务, 返回任务数
+  size_t doIterationEndFunctors();  // 运行runAfterIteration()登记的任务, 返回任务数
   void printActiveChannels() const; // 打印当前被触发的channel
+  Timestamp pollOnce();  // 等待事件放入activeChannels_, 需要时先忙轮询
 
   typedef std::vector<Channel*> ChannelList;  // 已经使用poll注册监听的channel
   bool looping_; // 是否处于循环
@@ -113,6 +152,7 @@ class EventLoop : noncopyable
   Timestamp pollReturnTime_;   // pollReturnTime_ poll返回的时间戳
   std::unique_ptr<Poller> poller_;  // poller_, IO多路复用
   std::unique_ptr<TimerQueue> timerQueue_;  // 定时器队列
+  std::shared_ptr<BufferPool> bufferPool_;  // 连接的输入输出缓冲区从这里借还
 
   int wakeupFd_;
   // unlike in TimerQueue, which is an internal class,
@@ -124,9 +164,15 @@ class EventLoop : noncopyable
   ChannelList activeChannels_;
   Channel* currentActiveChannel_;
 
-  mutable MutexLock mutex_;
-
-  std::vector<Functor> pendingFunctors_ GUARDED_BY(mutex_);   // 任务队列, 建立在线程栈中
+  std::atomic<bool> wakeupPending_;  // wakeupFd_已写入但loop还没开始处理任务队列, 用来合并多次wakeup
+  MpscQueue<Functor> pendingFunctors_;   // 任务队列, 无锁多生产者单消费者
+  std::vector<Functor> iterationEndFunctors_;  // 只在loop线程访问
+  std::vector<Functor> runningIterationEndFunctors_;  // 执行时交换过来, 两个vector的容量都复用
+  std::atomic<int> busyPollMaxUs_;
+  int64_t busyPollBudgetUs_;
+  int64_t avgWaitUs_;  // 最近poll等待时长的滑动平均
+  std::atomic<int> connectionCount_;  // 计数在分配连接的线程里加, 在本loop线程里减, 选择loop时在主线程读
+  LoopStats stats_;
 };
 
 }  // namespace net
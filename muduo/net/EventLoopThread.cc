@@ -1,18 +1,50 @@
 #include "muduo/net/EventLoopThread.h"
 
+#include "muduo/base/Logging.h"
 #include "muduo/net/EventLoop.h"
 
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+const int kMpolLocal = 4;  // MPOL_LOCAL, 不依赖libnuma的<numaif.h>
+
+/// 把当前线程绑定到cpu, 并让之后的内存分配优先使用本地node。
+/// 进程可能是用numactl --interleave等启动的, 线程会继承那个策略, 所以显式设为MPOL_LOCAL
+void bindToCpu(int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (::sched_setaffinity(0, sizeof set, &set) < 0)
+  {
+    LOG_SYSERR << "sched_setaffinity cpu " << cpu;
+    return;
+  }
+  if (::syscall(SYS_set_mempolicy, kMpolLocal, NULL, 0) < 0)
+  {
+    LOG_WARN << "set_mempolicy(MPOL_LOCAL) failed, relying on first-touch";
+  }
+}
+
+}  // namespace
+
 EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,  
-                                 const string& name)  // 用线程初始化回调函数构造函数
+                                 const string& name,
+                                 int cpu)  // 用线程初始化回调函数构造函数
   : loop_(NULL),  // loop_是指针, 指向子线程所有的loop_对象
     exiting_(false),
     thread_(std::bind(&EventLoopThread::threadFunc, this), name), //构造线程对象 注册绑定线程执行的函数, EventLoopThread::threadFunc
     mutex_(),
     cond_(mutex_),
-    callback_(cb) // 回调函数
+    callback_(cb), // 回调函数
+    cpu_(cpu)
 {
 }
 
@@ -49,6 +81,10 @@ EventLoop* EventLoopThread::startLoop() // (主线程)开启线程(执行函数)
 
 void EventLoopThread::threadFunc() // 新线程创建后执行的函数
 {
+  if (cpu_ >= 0)
+  {
+    bindToCpu(cpu_);  // 要在创建loop之前: poller、缓冲区池等都在这个线程里首次分配和访问
+  }
   // 新线程栈上创建eventloop对象, 关键啊, 这里也会配置好loop对象的threadId_
   EventLoop loop;
 
@@ -3,6 +3,9 @@
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThread.h"
 
+#include <random>
+
+#include <sched.h>
 #include <stdio.h>
 
 using namespace muduo;
@@ -32,7 +35,8 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) // 线程池的sta
 
     char buf[name_.size() + 32];
     snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i);  // 线程名储存到buf中
-    EventLoopThread* t = new EventLoopThread(cb, buf);  // 创建一个EventLoopThread
+    int cpu = implicit_cast<size_t>(i) < cpus_.size() ? cpus_[i] : -1;
+    EventLoopThread* t = new EventLoopThread(cb, buf, cpu);  // 创建一个EventLoopThread, 需要时绑定CPU
     threads_.push_back(std::unique_ptr<EventLoopThread>(t));  // 线程指针t用unique_ptr维护, 加入的线程列表中
     loops_.push_back(t->startLoop()); // t->startLoop()返回的loop_指针加入到执行loop列表中
   }
@@ -42,6 +46,31 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) // 线程池的sta
   }
 }
 
+void EventLoopThreadPool::setOneLoopPerCore()
+{
+  assert(!started_);
+  cpus_ = allowedCpus();
+  numThreads_ = static_cast<int>(cpus_.size());
+}
+
+std::vector<int> EventLoopThreadPool::allowedCpus()
+{
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof set, &set) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+      if (CPU_ISSET(cpu, &set))
+      {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
 EventLoop* EventLoopThreadPool::getNextLoop() // 返回下一个loop指针(可用的指针), 给tcpserver和client
 {
   baseLoop_->assertInLoopThread();
@@ -60,6 +89,136 @@ EventLoop* EventLoopThreadPool::getNextLoop() // 返回下一个loop指针(可
   return loop;  // loop对象指针
 }
 
+EventLoop* EventLoopThreadPool::selectLoop(size_t hashCode)
+{
+  baseLoop_->assertInLoopThread();
+  assert(started_);
+  if (loops_.empty() || !selector_)
+  {
+    return getNextLoop();
+  }
+  EventLoop* loop = selector_(loops_, hashCode);
+  assert(loop != NULL);
+  return loop;
+}
+
+namespace
+{
+
+/// 负载最小的loop。从上次的下一个位置开始扫描, 负载相同(比如都空闲)时退化为轮流分配, 而不是总选第一个
+template<typename Load>
+class LeastLoaded
+{
+ public:
+  explicit LeastLoaded(Load load)
+    : load_(load),
+      start_(0)
+  {
+  }
+
+  EventLoop* operator()(const std::vector<EventLoop*>& loops, size_t)
+  {
+    const size_t n = loops.size();
+    size_t best = start_ % n;
+    size_t bestLoad = load_(loops[best]);
+    for (size_t i = 1; i < n && bestLoad > 0; ++i)
+    {
+      size_t k = (start_ + i) % n;
+      size_t load = load_(loops[k]);
+      if (load < bestLoad)
+      {
+        best = k;
+        bestLoad = load;
+      }
+    }
+    start_ = best + 1;
+    return loops[best];
+  }
+
+ private:
+  Load load_;
+  size_t start_;
+};
+
+template<typename Load>
+LeastLoaded<Load> makeLeastLoaded(Load load)
+{
+  return LeastLoaded<Load>(load);
+}
+
+size_t connectionLoad(EventLoop* loop)
+{
+  return static_cast<size_t>(loop->connectionCount());
+}
+
+size_t queueLoad(EventLoop* loop)
+{
+  return loop->queueSize();
+}
+
+size_t combinedLoad(EventLoop* loop)
+{
+  return connectionLoad(loop) + queueLoad(loop);
+}
+
+/// 随机取两个不同的loop, 选负载小的。不需要扫描所有loop, 也避免了"最少"类策略在负载信息滞后时一窝蜂
+class PowerOfTwoChoices
+{
+ public:
+  PowerOfTwoChoices()
+    : rng_(std::random_device()())
+  {
+  }
+
+  EventLoop* operator()(const std::vector<EventLoop*>& loops, size_t)
+  {
+    const size_t n = loops.size();
+    if (n == 1)
+    {
+      return loops[0];
+    }
+    size_t a = rng_() % n;
+    size_t b = rng_() % (n - 1);
+    if (b >= a)
+    {
+      ++b;
+    }
+    return combinedLoad(loops[b]) < combinedLoad(loops[a]) ? loops[b] : loops[a];
+  }
+
+ private:
+  std::minstd_rand rng_;
+};
+
+EventLoop* peerAddressHash(const std::vector<EventLoop*>& loops, size_t hashCode)
+{
+  return loops[hashCode % loops.size()];
+}
+
+}  // namespace
+
+void EventLoopThreadPool::setSelectionPolicy(SelectionPolicy policy)
+{
+  switch (policy)
+  {
+    case kRoundRobin:
+      selector_ = LoopSelector();
+      break;
+    case kLeastConnections:
+      selector_ = makeLeastLoaded(connectionLoad);
+      break;
+    case kLeastQueueDepth:
+      selector_ = makeLeastLoaded(queueLoad);
+      break;
+    case kPowerOfTwoChoices:
+      selector_ = PowerOfTwoChoices();
+      break;
+    case kPeerAddressHash:
+      selector_ = peerAddressHash;
+      break;
+  }
+}
+
 EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode)
 {
   baseLoop_->assertInLoopThread();
@@ -22,12 +22,45 @@ class EventLoopThreadPool : noncopyable
  public:
   typedef std::function<void(EventLoop*)> ThreadInitCallback;  // 线程初始化回调函数
 
+  /// 给新连接选一个IO loop: loops非空, hashCode由调用者给出(TcpServer用对端IP的hash), 不需要的策略忽略它。
+  /// 只在baseLoop线程中调用, 可以在函数对象里保存状态
+  typedef std::function<EventLoop*(const std::vector<EventLoop*>& loops, size_t hashCode)> LoopSelector;
+
+  enum SelectionPolicy
+  {
+    kRoundRobin,  // 默认, 轮流分配
+    kLeastConnections,  // EventLoop::connectionCount()最少的
+    kLeastQueueDepth,  // EventLoop::queueSize()最小的, 即任务队列积压最少(被慢回调拖住的loop积压多)
+    kPowerOfTwoChoices,  // 随机取两个, 选连接数+队列长度较小的, O(1)且不会所有新连接都涌向同一个loop
+    kPeerAddressHash,  // 同一个对端IP总是落在同一个loop, 同getLoopForHash()
+  };
+
   EventLoopThreadPool(EventLoop* baseLoop, const string& nameArg);
   ~EventLoopThreadPool();
   void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+
+  /// 第i个IO线程绑定到cpus[i](线程多于cpus时多出的不绑定), 需要在start()之前调用。
+  /// 绑定后再创建loop, loop的内存来自该CPU所在的NUMA node, 见EventLoopThread
+  void setThreadCpus(const std::vector<int>& cpus) { cpus_ = cpus; }
+  /// 每个可用CPU一个IO线程并绑定, 代替setThreadNum()/setThreadCpus()
+  void setOneLoopPerCore();
+  /// 第i个IO线程绑定的CPU, 没有设置时为空
+  const std::vector<int>& threadCpus() const { return cpus_; }
+
+  /// 本进程可以运行的CPU(sched_getaffinity), 升序
+  static std::vector<int> allowedCpus();
   void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
-  EventLoop* getNextLoop(); // 返回一个可用的loop*
+  /// 内置策略, start()前后都可以设置
+  void setSelectionPolicy(SelectionPolicy policy);
+  /// 自定义策略, 空函数对象等于kRoundRobin
+  void setLoopSelector(const LoopSelector& selector)
+  { selector_ = selector; }
+
+  EventLoop* getNextLoop(); // 返回一个可用的loop*, 总是轮流分配, 与策略无关
+
+  /// 按当前策略选择; 没有IO线程时返回baseLoop
+  EventLoop* selectLoop(size_t hashCode);
 
   /// with the same hash code, it will always return the same EventLoop
   EventLoop* getLoopForHash(size_t hashCode);
@@ -48,9 +81,11 @@ class EventLoopThreadPool : noncopyable
   bool started_;
   int numThreads_;
   int next_;
+  std::vector<int> cpus_;  // 第i个IO线程绑定的CPU
 
   std::vector<std::unique_ptr<EventLoopThread>> threads_; // eventloopthread线程指针列表, 线程对象在堆上
   std::vector<EventLoop*> loops_; // eventloop对象指针的vector, loop对象建在线程对象内部
+  LoopSelector selector_;  // 为空时轮流分配
 };
 
 }  // namespace net
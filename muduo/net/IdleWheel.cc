@@ -0,0 +1,140 @@
+#include "muduo/net/IdleWheel.h"
+
+#include <assert.h>
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/TcpConnection.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int IdleWheel::kTicksPerTimeout;
+
+namespace
+{
+
+const int kNumSlots = IdleWheel::kTicksPerTimeout + 2;
+
+/// 最后活跃在lastTick的连接, 在这个tick检查时已经空闲了超过kTicksPerTimeout个完整的tick
+inline int64_t deadlineTick(int64_t lastTick)
+{
+  return lastTick + IdleWheel::kTicksPerTimeout + 1;
+}
+
+}  // namespace
+
+IdleWheel::IdleWheel(EventLoop* loop, double timeoutSeconds)
+  : loop_(loop),
+    currentTick_(0),
+    size_(0),
+    slots_(kNumSlots, static_cast<TcpConnection*>(NULL))
+{
+  timer_ = loop_->runEvery(timeoutSeconds / kTicksPerTimeout, std::bind(&IdleWheel::onTick, this));
+}
+
+IdleWheel::~IdleWheel()
+{
+  loop_->cancel(timer_);
+  for (TcpConnection*& head : slots_)
+  {
+    while (head)
+    {
+      TcpConnection* conn = head;
+      unlink(conn);
+      conn->idleWheel_ = NULL;
+    }
+  }
+}
+
+void IdleWheel::add(TcpConnection* conn)
+{
+  loop_->assertInLoopThread();
+  assert(conn->idleWheel_ == NULL);
+  conn->idleWheel_ = this;
+  conn->idleTick_ = currentTick_;
+  link(conn);
+  ++size_;
+}
+
+void IdleWheel::remove(TcpConnection* conn)
+{
+  loop_->assertInLoopThread();
+  if (conn->idleWheel_ != this)
+  {
+    return;
+  }
+  unlink(conn);
+  conn->idleWheel_ = NULL;
+  --size_;
+}
+
+void IdleWheel::onTick()
+{
+  ++currentTick_;
+  TcpConnection*& head = slots_[currentTick_ % kNumSlots];
+  TcpConnection* conn = head;
+  head = NULL;
+  while (conn)
+  {
+    TcpConnection* next = conn->idleNext_;
+    conn->idlePrev_ = NULL;
+    conn->idleNext_ = NULL;
+    conn->idleSlot_ = NULL;
+    if (deadlineTick(conn->idleTick_) <= currentTick_)
+    {
+      conn->idleWheel_ = NULL;
+      --size_;
+      expired_.push_back(conn->shared_from_this());
+    }
+    else
+    {
+      link(conn);  // 期间读写过, 挂到新的到期槽
+    }
+    conn = next;
+  }
+
+  if (!expired_.empty())
+  {
+    LOG_DEBUG << "IdleWheel::onTick closing " << expired_.size() << " idle connections";
+    for (const std::shared_ptr<TcpConnection>& expired : expired_)
+    {
+      expired->forceClose();
+    }
+    expired_.clear();
+  }
+}
+
+void IdleWheel::link(TcpConnection* conn)
+{
+  assert(deadlineTick(conn->idleTick_) > currentTick_);
+  TcpConnection** slot = &slots_[deadlineTick(conn->idleTick_) % kNumSlots];
+  conn->idleSlot_ = slot;
+  conn->idlePrev_ = NULL;
+  conn->idleNext_ = *slot;
+  if (*slot)
+  {
+    (*slot)->idlePrev_ = conn;
+  }
+  *slot = conn;
+}
+
+void IdleWheel::unlink(TcpConnection* conn)
+{
+  assert(conn->idleSlot_ != NULL);
+  if (conn->idlePrev_)
+  {
+    conn->idlePrev_->idleNext_ = conn->idleNext_;
+  }
+  else
+  {
+    *conn->idleSlot_ = conn->idleNext_;
+  }
+  if (conn->idleNext_)
+  {
+    conn->idleNext_->idlePrev_ = conn->idlePrev_;
+  }
+  conn->idlePrev_ = NULL;
+  conn->idleNext_ = NULL;
+  conn->idleSlot_ = NULL;
+}
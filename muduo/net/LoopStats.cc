@@ -0,0 +1,181 @@
+#include "muduo/net/LoopStats.h"
+
+#include <stdio.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+const int LoopStats::kBuckets;
+
+namespace
+{
+
+inline int bucketOf(int64_t value)
+{
+  if (value <= 0)
+  {
+    return 0;
+  }
+  int bits = 64 - __builtin_clzll(static_cast<unsigned long long>(value));
+  return bits < LoopStats::kBuckets ? bits : LoopStats::kBuckets - 1;
+}
+
+// 单写者, 不需要fetch_add
+inline void increase(std::atomic<int64_t>* counter, int64_t delta)
+{
+  counter->store(counter->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void appendHistogram(string* out, const char* name, const LoopStats::Histogram& h)
+{
+  char buf[256];
+  snprintf(buf, sizeof buf,
+           "%-22s count %-10lld avg %-10.1f p50 <%-8lld p99 <%-8lld p99.9 <%-8lld max %lld\n",
+           name, static_cast<long long>(h.count), h.mean(),
+           static_cast<long long>(h.percentile(0.5)),
+           static_cast<long long>(h.percentile(0.99)),
+           static_cast<long long>(h.percentile(0.999)),
+           static_cast<long long>(h.max));
+  out->append(buf);
+}
+
+}  // namespace
+
+int64_t LoopStats::Histogram::percentile(double p) const
+{
+  if (count <= 0)
+  {
+    return 0;
+  }
+  int64_t rank = static_cast<int64_t>(p * static_cast<double>(count - 1)) + 1;
+  int64_t seen = 0;
+  for (int i = 0; i < kBuckets; ++i)
+  {
+    seen += buckets[i];
+    if (seen >= rank)
+    {
+      return i < kBuckets - 1 ? int64_t(1) << i : max;
+    }
+  }
+  return max;
+}
+
+string LoopStats::Snapshot::toString() const
+{
+  string out;
+  char buf[64];
+  snprintf(buf, sizeof buf, "iterations %lld\n", static_cast<long long>(iterations));
+  out.append(buf);
+  appendHistogram(&out, "poll us", pollUs);
+  appendHistogram(&out, "handler us", handlerUs);
+  appendHistogram(&out, "functors us", functorsUs);
+  appendHistogram(&out, "functors/iteration", functorsPerIteration);
+  appendHistogram(&out, "active channels", activeChannels);
+  snprintf(buf, sizeof buf, "slowest handler fd %d\n", slowestHandlerFd);
+  out.append(buf);
+  return out;
+}
+
+LoopStats::AtomicHistogram::AtomicHistogram()
+  : count(0),
+    sum(0),
+    max(0)
+{
+  for (std::atomic<int64_t>& bucket : buckets)
+  {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void LoopStats::AtomicHistogram::add(int64_t value)
+{
+  increase(&count, 1);
+  increase(&sum, value);
+  increase(&buckets[bucketOf(value)], 1);
+  if (value > max.load(std::memory_order_relaxed))
+  {
+    max.store(value, std::memory_order_relaxed);
+  }
+}
+
+void LoopStats::AtomicHistogram::load(Histogram* out) const
+{
+  out->count = count.load(std::memory_order_relaxed);
+  out->sum = sum.load(std::memory_order_relaxed);
+  out->max = max.load(std::memory_order_relaxed);
+  for (int i = 0; i < kBuckets; ++i)
+  {
+    out->buckets[i] = buckets[i].load(std::memory_order_relaxed);
+  }
+}
+
+LoopStats::LoopStats()
+  : sequence_(0),
+    iterations_(0),
+    slowestHandlerFd_(-1)
+{
+}
+
+void LoopStats::beginWrite()
+{
+  sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);  // 计数的写不能排到变成奇数之前
+}
+
+void LoopStats::endWrite()
+{
+  sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LoopStats::recordPoll(int64_t waitUs, size_t activeChannels)
+{
+  beginWrite();
+  increase(&iterations_, 1);
+  poll_.add(waitUs);
+  activeChannels_.add(static_cast<int64_t>(activeChannels));
+  endWrite();
+}
+
+void LoopStats::recordHandler(int64_t us, int fd)
+{
+  beginWrite();
+  if (us > handler_.max.load(std::memory_order_relaxed))
+  {
+    slowestHandlerFd_.store(fd, std::memory_order_relaxed);
+  }
+  handler_.add(us);
+  endWrite();
+}
+
+void LoopStats::recordFunctors(int64_t us, size_t count)
+{
+  beginWrite();
+  functors_.add(us);
+  functorsPerIteration_.add(static_cast<int64_t>(count));
+  endWrite();
+}
+
+LoopStats::Snapshot LoopStats::snapshot() const
+{
+  Snapshot snap;
+  for (;;)
+  {
+    uint64_t before = sequence_.load(std::memory_order_acquire);
+    if (before & 1)
+    {
+      continue;  // loop线程正在写, 写一次只是几条指令
+    }
+    snap.iterations = iterations_.load(std::memory_order_relaxed);
+    poll_.load(&snap.pollUs);
+    handler_.load(&snap.handlerUs);
+    functors_.load(&snap.functorsUs);
+    functorsPerIteration_.load(&snap.functorsPerIteration);
+    activeChannels_.load(&snap.activeChannels);
+    snap.slowestHandlerFd = slowestHandlerFd_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);  // 上面的读不能排到再次读sequence_之后
+    if (sequence_.load(std::memory_order_relaxed) == before)
+    {
+      return snap;
+    }
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef MUDUO_NET_LOOPSTATS_H_
+#define MUDUO_NET_LOOPSTATS_H_
+
+#include <atomic>
+
+#include <stdint.h>
+
+#include "muduo/base/noncopyable.h"
+#include "muduo/base/Types.h"
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// Per-loop counters and histograms.
+/// EventLoop每轮循环的耗时统计, 用来估算线程数、找出阻塞loop的回调。
+///
+/// 只有loop线程写, 每次记录是几个relaxed的读写, 不加锁也没有原子的读改写;
+/// 任意线程可以用snapshot()取一份一致的副本(seqlock, 写到一半时读者重试)。
+/// 计数从loop开始累计, 两次快照相减就是这段时间的分布(max除外)。
+///
+class LoopStats : noncopyable
+{
+ public:
+  /// 桶0是0(耗时不到1微秒), 桶i(i >= 1)是[2^(i-1), 2^i), 最后一个桶包含更大的值
+  static const int kBuckets = 32;
+
+  struct Histogram
+  {
+    int64_t count;
+    int64_t sum;
+    int64_t max;
+    int64_t buckets[kBuckets];
+
+    double mean() const
+    { return count > 0 ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+
+    /// 第p(0~1)分位数所在桶的上界(不含), 最多偏大一倍
+    int64_t percentile(double p) const;
+  };
+
+  struct Snapshot
+  {
+    int64_t iterations;
+    Histogram pollUs;  // 每轮阻塞在poll中的微秒数, 包括忙轮询的空转
+    Histogram handlerUs;  // 每个channel回调的微秒数
+    Histogram functorsUs;  // 每轮执行任务队列和本轮结束任务的微秒数
+    Histogram functorsPerIteration;  // 每轮执行的任务数
+    Histogram activeChannels;  // 每次poll返回的活跃channel数
+    int slowestHandlerFd;  // 最慢的那次回调所属的fd, handlerUs.max就是它的耗时
+
+    string toString() const;
+  };
+
+  LoopStats();
+
+  // 以下只能在loop线程调用
+  void recordPoll(int64_t waitUs, size_t activeChannels);
+  void recordHandler(int64_t us, int fd);
+  void recordFunctors(int64_t us, size_t count);
+
+  /// 任意线程可调用
+  Snapshot snapshot() const;
+
+ private:
+  struct AtomicHistogram
+  {
+    AtomicHistogram();
+    void add(int64_t value);
+    void load(Histogram* out) const;
+
+    std::atomic<int64_t> count;
+    std::atomic<int64_t> sum;
+    std::atomic<int64_t> max;
+    std::atomic<int64_t> buckets[kBuckets];
+  };
+
+  void beginWrite();
+  void endWrite();
+
+  std::atomic<uint64_t> sequence_;  // 奇数表示正在写
+  std::atomic<int64_t> iterations_;
+  AtomicHistogram poll_;
+  AtomicHistogram handler_;
+  AtomicHistogram functors_;
+  AtomicHistogram functorsPerIteration_;
+  AtomicHistogram activeChannels_;
+  std::atomic<int> slowestHandlerFd_;
+};
+
+}  // namespace net
+}  // namespace muduo
+
+#endif  // MUDUO_NET_LOOPSTATS_H_
@@ -1,5 +1,6 @@
 #include "muduo/net/Poller.h"
 
+#include "muduo/base/Logging.h"
 #include "muduo/net/Channel.h"
 
 using namespace muduo;
@@ -13,11 +14,24 @@ Poller::Poller(EventLoop* loop)
 
 Poller::~Poller() = default;
 
-/// 是否拥有(监听)某个channel, 使用find查找
+/// 是否拥有(监听)某个channel, 按fd下标查表
 bool Poller::hasChannel(Channel* channel) const
 {
   assertInLoopThread();
-  ChannelMap::const_iterator it = channels_.find(channel->fd());
-  return it != channels_.end() && it->second == channel;
+  return channels_.find(channel->fd()) == channel;
 }
 
+void Poller::asyncRead(Channel*)
+{
+  LOG_FATAL << "Poller::asyncRead not supported";
+}
+
+void Poller::asyncWrite(Channel*, const struct iovec*, int)
+{
+  LOG_FATAL << "Poller::asyncWrite not supported";
+}
+
+void Poller::cancelAsyncIo(Channel*, bool, bool)
+{
+  LOG_FATAL << "Poller::cancelAsyncIo not supported";
+}
@@ -1,10 +1,13 @@
 #ifndef MUDUO_NET_POLLER_H_
 #define MUDUO_NET_POLLER_H_
 
-#include <map>
+#include <algorithm>
 #include <vector>
 
+#include <assert.h>
+
 #include "muduo/base/Timestamp.h"
+#include "muduo/base/Types.h"
 #include "muduo/net/EventLoop.h"
 
 namespace muduo
@@ -41,6 +44,18 @@ class Poller : noncopyable
 
   virtual bool hasChannel(Channel* channel) const;
 
+  /// 是否支持Channel::setEdgeTriggered(), poll(2)和io_uring的实现都是水平触发
+  virtual bool supportsEdgeTriggered() const { return false; }
+
+  /// 是否支持异步读写(Channel::setAsyncIo()), 目前只有io_uring的实现支持
+  virtual bool supportsAsyncIo() const { return false; }
+  /// 提交一次读, 数据读进poller自己的缓冲区。每个channel同时最多一个读和一个写
+  virtual void asyncRead(Channel* channel);
+  /// 提交一次写, iov数组和它指向的内存在完成之前都不能改动或释放
+  virtual void asyncWrite(Channel* channel, const struct iovec* iov, int iovcnt);
+  /// 取消channel未完成的读/写, 被取消的操作仍会完成(结果一般为-ECANCELED)
+  virtual void cancelAsyncIo(Channel* channel, bool read, bool write);
+
   static Poller* newDefaultPoller(EventLoop* loop);
 
   void assertInLoopThread() const
@@ -49,9 +64,45 @@ class Poller : noncopyable
   }
 
  protected:
- /// 一个fd->channel 的map
-  typedef std::map<int, Channel*> ChannelMap; // 根据连接的fd找到其Channel
-  ChannelMap channels_; // channels_是一个map
+  /// fd->channel 的表。fd是从小到大复用的稠密整数, 直接用fd作下标, 按需增长, 不再为每个fd分配树节点
+  class ChannelTable
+  {
+   public:
+    ChannelTable() : size_(0) {}
+
+    Channel* find(int fd) const  // 没有时返回NULL
+    { return implicit_cast<size_t>(fd) < channels_.size() ? channels_[fd] : NULL; }
+
+    void insert(int fd, Channel* channel)
+    {
+      if (implicit_cast<size_t>(fd) >= channels_.size())
+      {
+        channels_.resize(std::max(implicit_cast<size_t>(fd) + 1, channels_.size() * 2));
+      }
+      assert(channels_[fd] == NULL);
+      channels_[fd] = channel;
+      ++size_;
+    }
+
+    size_t erase(int fd)
+    {
+      if (find(fd) == NULL)
+      {
+        return 0;
+      }
+      channels_[fd] = NULL;
+      --size_;
+      return 1;
+    }
+
+    size_t size() const { return size_; }
+
+   private:
+    std::vector<Channel*> channels_;
+    size_t size_;
+  };
+
+  ChannelTable channels_; // 根据连接的fd找到其Channel
 
  private:
   EventLoop* ownerLoop_;  // 指向持有poll的loop
@@ -2,6 +2,7 @@
 
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <linux/filter.h>
 #include <stdio.h>  // snprintf
 
 #include "muduo/base/Logging.h"
@@ -111,6 +112,92 @@ void Socket::setReusePort(bool on)
 #endif
 }
 
+bool Socket::attachReusePortCpuFilter(int groupSize)
+{
+  return attachReusePortCpuFilter(std::vector<int>(), groupSize);
+}
+
+bool Socket::attachReusePortCpuFilter(const std::vector<int>& loopCpus)
+{
+  return attachReusePortCpuFilter(loopCpus, static_cast<int>(loopCpus.size()));
+}
+
+bool Socket::attachReusePortCpuFilter(const std::vector<int>& loopCpus, int groupSize)
+{
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+  // A = cpu; if (A == loopCpus[i]) return i; ...; A = A % groupSize; return A
+  std::vector<struct sock_filter> code;
+  code.push_back({ BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) });
+  for (size_t i = 0; i < loopCpus.size(); ++i)
+  {
+    code.push_back({ BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<uint32_t>(loopCpus[i]) });  // 不等时跳过下一条
+    code.push_back({ BPF_RET | BPF_K, 0, 0, static_cast<uint32_t>(i) });
+  }
+  code.push_back({ BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(groupSize) });
+  code.push_back({ BPF_RET | BPF_A, 0, 0, 0 });
+  if (groupSize <= 0 || code.size() > BPF_MAXINSNS)
+  {
+    LOG_ERROR << "Socket::attachReusePortCpuFilter invalid group size " << groupSize;
+    return false;
+  }
+  struct sock_fprog prog;
+  prog.len = static_cast<unsigned short>(code.size());
+  prog.filter = code.data();
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                         &prog, static_cast<socklen_t>(sizeof prog));
+  if (ret < 0)
+  {
+    LOG_SYSERR << "SO_ATTACH_REUSEPORT_CBPF failed.";
+    return false;
+  }
+  return true;
+#else
+  LOG_ERROR << "SO_ATTACH_REUSEPORT_CBPF is not supported.";
+  return false;
+#endif
+}
+
+bool Socket::setBusyPoll(int usec)
+{
+#ifdef SO_BUSY_POLL
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL,
+                         &usec, static_cast<socklen_t>(sizeof usec));
+  if (ret < 0 && usec > 0)
+  {
+    LOG_SYSERR << "SO_BUSY_POLL failed.";
+    return false;
+  }
+  return ret == 0;
+#else
+  if (usec > 0)
+  {
+    LOG_ERROR << "SO_BUSY_POLL is not supported.";
+  }
+  return false;
+#endif
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+#ifdef SO_ZEROCOPY
+  int optval = on ? 1 : 0;
+  int ret = ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY,
+                         &optval, static_cast<socklen_t>(sizeof optval));
+  if (ret < 0 && on)
+  {
+    LOG_SYSERR << "SO_ZEROCOPY failed.";
+    return false;
+  }
+  return ret == 0;
+#else
+  if (on)
+  {
+    LOG_ERROR << "SO_ZEROCOPY is not supported.";
+  }
+  return false;
+#endif
+}
+
 void Socket::setKeepAlive(bool on)
 {
   int optval = on ? 1 : 0;
@@ -3,6 +3,8 @@
 
 #include "muduo/base/noncopyable.h"
 
+#include <vector>
+
 // struct tcp_info is in <netinet/tcp.h>
 struct tcp_info;
 
@@ -63,12 +65,38 @@ class Socket : noncopyable  // Socket类
   ///
   void setReusePort(bool on);
 
+  ///
+  /// Attach a classic BPF program to the SO_REUSEPORT group,
+  /// steering each new connection to socket (cpu % groupSize).
+  /// 按收到连接的CPU选择组内第几个socket(按listen的顺序), 需要各loop线程绑定到对应CPU才有意义
+  /// return true if success.
+  bool attachReusePortCpuFilter(int groupSize);
+
+  ///
+  /// Same as above, but connections received on loopCpus[i] go to socket i,
+  /// other CPUs fall back to (cpu % loopCpus.size()).
+  /// IO线程绑定的CPU不是0, 1, 2...时用这个, 比如setOneLoopPerCore()后进程只能用部分CPU
+  bool attachReusePortCpuFilter(const std::vector<int>& loopCpus);
+
+  ///
+  /// Enable/disable SO_ZEROCOPY, required before sending with MSG_ZEROCOPY.
+  /// return true if success.
+  bool setZeroCopy(bool on);
+
+  ///
+  /// SO_BUSY_POLL: blocking reads busy-poll the device queue for up to usec microseconds.
+  /// 超过net.core.busy_read的值需要CAP_NET_ADMIN, 0表示关闭
+  /// return true if success.
+  bool setBusyPoll(int usec);
+
   ///
   /// Enable/disable SO_KEEPALIVE
   ///
   void setKeepAlive(bool on); // keep alive, 当客户端端等待超过一定时间后自动给服务端发送一个空的报文，如果对方回复了这个报文证明连接还存活着
 
  private:
+  bool attachReusePortCpuFilter(const std::vector<int>& loopCpus, int groupSize);
+
   const int sockfd_;
 };
 
@@ -6,9 +6,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
 #include <stdio.h>  // snprintf
+#include <sys/sendfile.h>
 #include <sys/socket.h> // socket
-#include <sys/uio.h>  // readv
+#include <sys/uio.h>  // readv, writev
 #include <unistd.h>
 
 using namespace muduo;
@@ -174,6 +177,54 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
   return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+  return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t sockets::sendfile(int sockfd, int fileFd, off_t* offset, size_t count)
+{
+  return ::sendfile(sockfd, fileFd, offset, count);
+}
+
+ssize_t sockets::sendZeroCopy(int sockfd, const void *buf, size_t count)
+{
+#ifdef MSG_ZEROCOPY
+  return ::send(sockfd, buf, count, MSG_ZEROCOPY);
+#else
+  return ::send(sockfd, buf, count, 0);
+#endif
+}
+
+int sockets::recvZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi)
+{
+  char control[128];
+  struct msghdr msg;
+  memZero(&msg, sizeof msg);
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof control;
+  if (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) < 0)
+  {
+    return 0;  // EAGAIN
+  }
+  for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+  {
+    if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+        || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+    {
+      const struct sock_extended_err* serr =
+          reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+      if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+      {
+        *lo = serr->ee_info;
+        *hi = serr->ee_data;
+        return 1;
+      }
+    }
+  }
+  return -1;
+}
+
 void sockets::close(int sockfd)
 {
   if (::close(sockfd) < 0)
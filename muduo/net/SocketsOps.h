@@ -23,6 +23,12 @@ int  accept(int sockfd, struct sockaddr_in6* addr); // accept某个连接,addr
 ssize_t read(int sockfd, void *buf, size_t count);  // read count 字节到buf
 ssize_t readv(int sockfd, const struct iovec *iov, int iovcnt); // 成批的读取并格式化为iovcnt个iovec
 ssize_t write(int sockfd, const void *buf, size_t count);   // write count个字节到buf中
+ssize_t writev(int sockfd, const struct iovec *iov, int iovcnt);  // 一次写出iovcnt个不连续的内存块
+ssize_t sendfile(int sockfd, int fileFd, off_t* offset, size_t count);  // 在内核中把文件[*offset, *offset+count)发到socket, 更新*offset
+ssize_t sendZeroCopy(int sockfd, const void *buf, size_t count);  // send(MSG_ZEROCOPY), 内存在完成通知之前不能释放或修改
+/// 从错误队列读一条MSG_ZEROCOPY完成通知, 第[*lo, *hi]次发送已完成。
+/// 返回1表示读到完成通知, 0表示队列已空, -1表示读到其他消息
+int recvZeroCopyCompletion(int sockfd, uint32_t* lo, uint32_t* hi);
 void close(int sockfd); // 关闭某个fd连接
 void shutdownWrite(int sockfd);
 
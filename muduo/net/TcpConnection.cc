@@ -1,9 +1,12 @@
 #include "muduo/net/TcpConnection.h"
 
 #include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "muduo/base/Logging.h"
 #include "muduo/base/WeakCallback.h"
+#include "muduo/net/BufferPool.h"
 #include "muduo/net/Channel.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/Socket.h"
@@ -27,20 +30,56 @@ void muduo::net::defaultMessageCallback(const TcpConnectionPtr&,
   buf->retrieveAll(); 
 }
 
+const size_t TcpConnection::kEdgeTriggeredBudget;
+
 TcpConnection::TcpConnection(EventLoop* loop,
                              const string& nameArg,
                              int sockfd,
                              const InetAddress& localAddr,
+                             const InetAddress& peerAddr)
+  : TcpConnection(loop, std::shared_ptr<const string>(), 0, sockfd, localAddr, peerAddr)
+{
+  name_ = nameArg;
+  LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
+            << " fd=" << sockfd;
+}
+
+TcpConnection::TcpConnection(EventLoop* loop,
+                             const std::shared_ptr<const string>& namePrefix,
+                             uint64_t id,
+                             int sockfd,
+                             const InetAddress& localAddr,
                              const InetAddress& peerAddr) // 构造函数, 用所属loop对象指针, sockfd, Addr
   : loop_(loop), // loop指针
-    name_(nameArg),
+    id_(id),
+    namePrefix_(namePrefix),
     state_(kConnecting),
     reading_(true),
+    edgeTriggered_(false),
+    autoCork_(false),
+    corkFlushQueued_(false),
+    asyncIo_(loop->supportsAsyncIo()),
+    readInFlight_(false),
+    writeInFlight_(false),
     socket_(new Socket(sockfd)),  // 用sockfd创建Socket
     channel_(new Channel(loop, sockfd)), // 用loop指针和sockfd创建Channel
     localAddr_(localAddr),
     peerAddr_(peerAddr),
-    highWaterMark_(64*1024*1024)
+    highWaterMark_(64*1024*1024),
+    backpressureHigh_(0),
+    backpressureLow_(0),
+    readPausedByBackpressure_(false),
+    zeroCopyThreshold_(0),
+    bufferPool_(loop->bufferPool()),
+    inputBuffer_(0),  // 第一次读之前从池中借
+    outputBuffer_(bufferPool_.get()),
+    pendingSends_(NULL),
+    sendQueued_(false),
+    idleWheel_(NULL),
+    idleTick_(0),
+    idlePrev_(NULL),
+    idleNext_(NULL),
+    idleSlot_(NULL)
 {
   // tcpconnection的回调函数注册到channel中
   channel_->setReadCallback(
@@ -52,14 +91,28 @@ TcpConnection::TcpConnection(EventLoop* loop,
       std::bind(&TcpConnection::handleClose, this));  // Channel关闭回调函数&TcpConnection::handleClose
   channel_->setErrorCallback(
       std::bind(&TcpConnection::handleError, this));  // Channel错误回调函数
-  LOG_DEBUG << "TcpConnection::ctor[" <<  name_ << "] at " << this
-            << " fd=" << sockfd;
+  channel_->setAsyncIo(asyncIo_);
+  if (namePrefix_)
+  {
+    LOG_DEBUG << "TcpConnection::ctor[" <<  name() << "] at " << this
+              << " fd=" << sockfd;
+  }
   socket_->setKeepAlive(true);  // 设置socket_为keepAlive
+  loop_->addConnectionCount(1);  // 在分配loop的线程中立即计入, 连续到来的连接能看到前一个
+}
+
+const string& TcpConnection::name() const
+{
+  if (namePrefix_)  // 每次accept都格式化名字太浪费, 只在真正用到(一般是打日志)时拼一次
+  {
+    std::call_once(nameOnce_, [this] { name_ = *namePrefix_ + std::to_string(id_); });
+  }
+  return name_;
 }
 
 TcpConnection::~TcpConnection()
 {
-  LOG_DEBUG << "TcpConnection::dtor[" <<  name_ << "] at " << this
+  LOG_DEBUG << "TcpConnection::dtor[" <<  name() << "] at " << this
             << " fd=" << channel_->fd()
             << " state=" << stateToString();
   assert(state_ == kDisconnected);
@@ -93,11 +146,44 @@ void TcpConnection::send(const StringPiece& message) /// 发送信息， StringP
     }
     else
     {
-      void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop; // 函数指针, 指向传入message函数, &TcpConnection::sendInLoop
-      loop_->runInLoop(
-          std::bind(fp,
-                    this, 
-                    message.as_string()));  // 加入到loop所在线程的等待队列
+      // 拷贝进待发送链的slab, 不再构造string和bind对象
+      queueSend([&message](ChainBuffer* pending) { pending->append(message); });
+    }
+  }
+}
+
+void TcpConnection::send(string&& message)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendInLoop(message.data(), message.size());
+    }
+    else if (message.size() >= ChainBuffer::kMinSliceSize)
+    {
+      // 存储移进共享的string, 挂到链上只增加引用计数
+      std::shared_ptr<const string> slice(std::make_shared<string>(std::move(message)));
+      queueSend([&slice](ChainBuffer* pending) { pending->appendSlice(slice); });
+    }
+    else
+    {
+      queueSend([&message](ChainBuffer* pending) { pending->append(message); });
+    }
+  }
+}
+
+void TcpConnection::send(const std::shared_ptr<const string>& message)
+{
+  if (state_ == kConnected)
+  {
+    if (loop_->isInLoopThread())
+    {
+      sendInLoop(message);
+    }
+    else
+    {
+      queueSend([&message](ChainBuffer* pending) { pending->appendSlice(message); });
     }
   }
 }
@@ -108,16 +194,77 @@ void TcpConnection::send(Buffer* buf) // 发送字符串到Channel(fd)
   {
     if (loop_->isInLoopThread())
     {
-      sendInLoop(buf->peek(), buf->readableBytes());  // 调用sendInLoop发送信息
-      buf->retrieveAll();   // 重置buf
+      sendInLoop(buf);  // 调用sendInLoop发送信息, buf被取空
+    }
+    else
+    {
+      queueSend([buf](ChainBuffer* pending) { pending->append(buf); });  // 小块拷贝, 大块取走buf的存储
+    }
+  }
+}
+
+template<typename Append>
+void TcpConnection::queueSend(Append append)
+{
+  bool post = false;
+  {
+    MutexLockGuard lock(sendMutex_);
+    append(&pendingSends_);
+    post = !sendQueued_;
+    sendQueued_ = true;
+  }
+  if (post)  // 前面的任务还没执行时, 这次的数据会被它一起发出
+  {
+    loop_->queueInLoop(std::bind(&TcpConnection::sendPendingInLoop, shared_from_this()));
+  }
+}
+
+void TcpConnection::sendPendingInLoop()
+{
+  loop_->assertInLoopThread();
+  ChainBuffer pending;
+  {
+    MutexLockGuard lock(sendMutex_);
+    pending.append(&pendingSends_);
+    sendQueued_ = false;
+  }
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    return;
+  }
+  if (pending.readableBytes() == 0)
+  {
+    return;
+  }
+  bool idle = !channel_->isWriting() && outputBuffer_.readableBytes() == 0;
+  queueOutput(pending.readableBytes());
+  outputBuffer_.append(&pending);  // 整条链转移, 不拷贝
+  if (idle && !autoCork_ && !asyncIo_)  // 直接用writev写出, 写不完的等可写事件
+  {
+    handleWrite();
+  }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+  if (state_ == kConnected)
+  {
+    int fileFd = ::dup(fd);  // outputBuffer_持有自己的副本, 发送完后关闭
+    if (fileFd < 0)
+    {
+      LOG_SYSERR << "TcpConnection::sendFile";
+      return;
+    }
+    if (loop_->isInLoopThread())
+    {
+      sendFileInLoop(fileFd, offset, len);
     }
     else
     {
-      void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop; // 函数指针运行fp
-      loop_->runInLoop(
-          std::bind(fp,
-                    this, 
-                    buf->retrieveAllAsString()));
+      // 和send()一样排进pendingSends_, 与其他线程发送的数据保持先后顺序;
+      // 连接已断开时pending链析构会关闭fileFd
+      queueSend([fileFd, offset, len](ChainBuffer* pending) { pending->appendFile(fileFd, offset, len); });
     }
   }
 }
@@ -128,24 +275,118 @@ void TcpConnection::sendInLoop(const StringPiece& message)  // 调用TcpConnecti
 }
 
 void TcpConnection::sendInLoop(const void* data, size_t len)  // 发送data数据到fd write缓冲区
+{
+  ssize_t nwrote = writeDirectly(data, len);
+  if (nwrote >= 0 && static_cast<size_t>(nwrote) < len) // 这可能是有要读的字节, 或者sockets::write一次没写完
+  {
+    size_t remaining = len - nwrote;
+    queueOutput(remaining);
+    outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);     // 没写完的字节remaining放入outputbuffer中, 先不调用write
+  }
+}
+
+void TcpConnection::sendInLoop(const std::shared_ptr<const string>& message)
+{
+  ssize_t nwrote = writeDirectly(message->data(), message->size());
+  if (nwrote >= 0 && static_cast<size_t>(nwrote) < message->size())
+  {
+    size_t remaining = message->size() - nwrote;
+    queueOutput(remaining);
+    outputBuffer_.appendSlice(message, message->data() + nwrote, remaining);  // 只增加引用计数
+  }
+}
+
+void TcpConnection::sendInLoop(Buffer* buf)
+{
+  if (zeroCopyThreshold_ > 0 && buf->readableBytes() >= zeroCopyThreshold_ && state_ != kDisconnected)
+  {
+    // 大块数据不走write的拷贝路径, 整体挂到outputBuffer_上用MSG_ZEROCOPY发送
+    bool idle = outputBuffer_.readableBytes() == 0;
+    queueOutput(buf->readableBytes());
+    outputBuffer_.append(buf);
+    if (idle && !autoCork_)  // 前面有排队的数据时等可写事件
+    {
+      handleWrite();
+    }
+    return;
+  }
+  ssize_t nwrote = writeDirectly(buf->peek(), buf->readableBytes());
+  if (nwrote >= 0 && static_cast<size_t>(nwrote) < buf->readableBytes())
+  {
+    buf->retrieve(nwrote);
+    queueOutput(buf->readableBytes());
+    outputBuffer_.append(buf);  // 大块直接把buf的存储挂到链上
+  }
+  else
+  {
+    buf->retrieveAll();   // 重置buf
+  }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
 {
   loop_->assertInLoopThread();
-  ssize_t nwrote = 0;
-  size_t remaining = len;
-  bool faultError = false;
   if (state_ == kDisconnected)
   {
     LOG_WARN << "disconnected, give up writing";
+    ::close(fd);
     return;
   }
-  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) // channel通道没有在写, 且没有要读的字节(读写索引一致)
+  if (len == 0)
+  {
+    ::close(fd);
+    return;
+  }
+  size_t nsent = 0;
+  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) // 前面没有排队的数据, 直接sendfile
+  {
+    ssize_t n = sockets::sendfile(channel_->fd(), fd, &offset, len);
+    if (n > 0)
+    {
+      nsent = n;
+      if (nsent == len)
+      {
+        ::close(fd);
+        if (writeCompleteCallback_)
+        {
+          loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+        }
+        return;
+      }
+    }
+    else if (n < 0 && errno != EWOULDBLOCK)
+    {
+      LOG_SYSERR << "TcpConnection::sendFileInLoop";
+      if (errno == EPIPE || errno == ECONNRESET)
+      {
+        ::close(fd);
+        return;
+      }
+    }
+  }
+  // 剩下的文件区域排在outputBuffer_最后, 可写时由handleWrite继续sendfile
+  queueOutput(len - nsent);
+  outputBuffer_.appendFile(fd, offset, len - nsent);
+}
+
+// outputBuffer_为空时直接写fd, 返回写了多少字节; 连接已断开或者出错(EPIPE等)时返回-1, 剩下的数据不再排队
+ssize_t TcpConnection::writeDirectly(const void* data, size_t len)
+{
+  loop_->assertInLoopThread();
+  ssize_t nwrote = 0;
+  if (state_ == kDisconnected)
+  {
+    LOG_WARN << "disconnected, give up writing";
+    return -1;
+  }
+  if (!autoCork_ && !asyncIo_ && !channel_->isWriting() && outputBuffer_.readableBytes() == 0) // channel通道没有在写, 且没有要读的字节(读写索引一致)
   {
     nwrote = sockets::write(channel_->fd(), data, len); // 直接调用socket::write向channel_的fd写data数据
 
     if (nwrote >= 0)  //  写成功, 写了nwrote个字节
     {
-      remaining = len - nwrote; // 是否有没写完的字节
-      if (remaining == 0 && writeCompleteCallback_) // 全部字节已经写完
+      touchIdle();
+      if (implicit_cast<size_t>(nwrote) == len && writeCompleteCallback_) // 全部字节已经写完
       {
         loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this())); // 调用写毕回调, 将writeCompleteCallback_回调函数加入所属loop队列的中, 唤醒子线程执行
       }
@@ -158,29 +399,45 @@ void TcpConnection::sendInLoop(const void* data, size_t len)  // 发送data数
         LOG_SYSERR << "TcpConnection::sendInLoop";
         if (errno == EPIPE || errno == ECONNRESET) // FIXME: any others?
         {
-          faultError = true;
+          return -1;
         }
       }
     }
   }
-  assert(remaining <= len);
-  if (!faultError && remaining > 0) // 这可能是有要读的字节, 或者sockets::write一次没写完
-  {
-    size_t oldLen = outputBuffer_.readableBytes();  // outputBuffer的可读字节数(TcpConnection去写)
-    if (oldLen + remaining >= highWaterMark_
-        && oldLen < highWaterMark_
-        && highWaterMarkCallback_)
-    {
-      loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
-    }
+  return nwrote;
+}
 
-    outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);     // 没写完的字节remaining放入outputbuffer中, 先不调用write
-    if (!channel_->isWriting())
+// 即将有len个字节放入outputBuffer_, 检查高水位并开始监听可写; 自动cork时留到本轮结束再写
+void TcpConnection::queueOutput(size_t len)
+{
+  touchIdle();
+  size_t oldLen = outputBuffer_.readableBytes();  // outputBuffer的可读字节数(TcpConnection去写)
+  if (oldLen + len >= highWaterMark_
+      && oldLen < highWaterMark_
+      && highWaterMarkCallback_)
+  {
+    loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
+  }
+  if (backpressureHigh_ > 0 && oldLen + len > backpressureHigh_ && reading_)
+  {
+    stopReadInLoop();
+    readPausedByBackpressure_ = true;
+  }
+  if ((autoCork_ || asyncIo_) && !channel_->isWriting())
+  {
+    if (!corkFlushQueued_)
     {
-      channel_->enableWriting();  // TcpConnection设置channel可写监听(能写了好调用handleWrite继续写) 
+      corkFlushQueued_ = true;
+      loop_->runAfterIteration(std::bind(&TcpConnection::flushCorked, shared_from_this()));
     }
+    return;
+  }
+  if (!channel_->isWriting())
+  {
+    channel_->enableWriting();  // TcpConnection设置channel可写监听(能写了好调用handleWrite继续写) 
   }
 }
+
 void TcpConnection::shutdown() // TcpConnection执行&TcpConnection::shutdownInLoop
 {
   if (state_ == kConnected)
@@ -192,13 +449,55 @@ void TcpConnection::shutdown() // TcpConnection执行&TcpConnection::shutdownInL
 void TcpConnection::shutdownInLoop()
 {
   loop_->assertInLoopThread();
-  if (!channel_->isWriting()) // channel不在写
+  if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) // channel不在写, 也没有cork住的数据(它们写完后会再调用这里)
   {
     // we are not writing
     socket_->shutdownWrite(); // 关闭写
   }
 }
 
+void TcpConnection::flushCorked()
+{
+  loop_->assertInLoopThread();
+  corkFlushQueued_ = false;
+  if (state_ == kDisconnected || channel_->isWriting() || writeInFlight_
+      || outputBuffer_.readableBytes() == 0)
+  {
+    return;  // 已经在等可写事件或者异步写完成的由handleWrite接着写
+  }
+  if (asyncIo_ && submitAsyncWrite())
+  {
+    return;
+  }
+  int savedErrno = 0;
+  ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno, zeroCopyThreshold_);  // 本轮的send合并成一次writev
+  resumeReadIfDrained();
+  if (outputBuffer_.readableBytes() == 0)
+  {
+    if (writeCompleteCallback_)
+    {
+      loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting)
+    {
+      shutdownInLoop();
+    }
+  }
+  else if (n >= 0 || savedErrno == EWOULDBLOCK)
+  {
+    channel_->enableWriting();  // 没写完的等可写事件
+  }
+  else
+  {
+    errno = savedErrno;
+    LOG_SYSERR << "TcpConnection::flushCorked";
+    if (savedErrno == EIO)  // sendFile的文件比声明的短
+    {
+      forceCloseInLoop();
+    }
+  }
+}
+
 void TcpConnection::forceClose() // 强制关闭, 执行&TcpConnection::forceCloseInLoop
 { 
   // FIXME: use compare and swap
@@ -226,6 +525,12 @@ void TcpConnection::forceCloseInLoop()
   loop_->assertInLoopThread();
   if (state_ == kConnected || state_ == kDisconnecting)
   {
+    if (corkFlushQueued_ && !writeInFlight_ && !channel_->isWriting())
+    {
+      // 不cork时send已经直接write了; cork住还没写出的数据在关闭前同步写一次
+      int savedErrno = 0;
+      outputBuffer_.writeFd(channel_->fd(), &savedErrno, zeroCopyThreshold_);
+    }
     handleClose();  // 关闭处理函数
   }
 }
@@ -252,6 +557,32 @@ void TcpConnection::setTcpNoDelay(bool on)
   socket_->setTcpNoDelay(on);
 }
 
+void TcpConnection::setBusyPoll(int usec)
+{
+  socket_->setBusyPoll(usec);
+}
+
+void TcpConnection::setZeroCopyThreshold(size_t threshold)
+{
+  loop_->assertInLoopThread();
+  if (asyncIo_)
+  {
+    return;  // 异步写没有错误队列的完成通知, 保持普通发送
+  }
+  if (threshold > 0 && zeroCopyThreshold_ == 0 && !socket_->setZeroCopy(true))
+  {
+    return;  // 内核不支持, 保持普通发送
+  }
+  zeroCopyThreshold_ = threshold;
+}
+
+void TcpConnection::setEdgeTriggered(bool on)
+{
+  assert(state_ == kConnecting);
+  edgeTriggered_ = on && loop_->supportsEdgeTriggered();
+  channel_->setEdgeTriggered(edgeTriggered_);
+}
+
 void TcpConnection::startRead() // 开始读
 {
   loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
@@ -260,11 +591,16 @@ void TcpConnection::startRead() // 开始读
 void TcpConnection::startReadInLoop()
 {
   loop_->assertInLoopThread();
+  readPausedByBackpressure_ = false;
   if (!reading_ || !channel_->isReading())   // 设置channel可读
   {
     channel_->enableReading();
     reading_ = true;
   }
+  if (asyncIo_)
+  {
+    submitAsyncRead();
+  }
 }
 
 void TcpConnection::stopRead()
@@ -275,11 +611,25 @@ void TcpConnection::stopRead()
 void TcpConnection::stopReadInLoop()
 {
   loop_->assertInLoopThread();
+  readPausedByBackpressure_ = false;
   if (reading_ || channel_->isReading())
   {
     channel_->disableReading();
     reading_ = false;
   }
+  if (asyncIo_ && readInFlight_)
+  {
+    loop_->cancelAsyncIo(channel_.get(), true, false);  // 已经读到的数据仍会交给messageCallback_
+  }
+}
+
+void TcpConnection::resumeReadIfDrained()
+{
+  if (readPausedByBackpressure_ && outputBuffer_.readableBytes() <= backpressureLow_
+      && (state_ == kConnected || state_ == kDisconnecting))
+  {
+    startReadInLoop();
+  }
 }
 
 // master线程将该方法放入工作线程的队列, 使工作线程执行该方法, 将连接事件注册到epoll 红黑树中, 并设置连接回调函数
@@ -290,6 +640,10 @@ void TcpConnection::connectEstablished()  // Tcp连接建立, Acceptor的accept
   setState(kConnected);
   channel_->tie(shared_from_this());  // channel绑定到Connection,实现channel到Connection的调用
   channel_->enableReading();  // 设置channel_监听可读事件, 注册channel到poll中。可读可写回调函数在创建TcpConnection的时候就已注册, enableReading只是将fd注入
+  if (asyncIo_)
+  {
+    submitAsyncRead();
+  }
   connectionCallback_(shared_from_this());   // 连接回调函数
 }
 
@@ -303,19 +657,42 @@ void TcpConnection::connectDestroyed() // 连接销毁， 关闭channel
     channel_->disableAll();     // 关闭channel, 设置channel为空事件
     connectionCallback_(shared_from_this());
   }
-  channel_->remove();
+  if (readInFlight_ || writeInFlight_)
+  {
+    // 内核还在往读缓冲区写或者从outputBuffer_读, 取消它们, 都完成后由finishAsyncIo删除channel
+    asyncGuard_ = shared_from_this();
+    loop_->cancelAsyncIo(channel_.get(), readInFlight_, writeInFlight_);
+  }
+  else
+  {
+    channel_->remove();
+  }
+  loop_->addConnectionCount(-1);  // 对象可能比loop活得久, 不能留到析构函数里做
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime) // handleRead, Channel可读事件后调用这个函数。该函数先read数据到缓冲区, 再调用合理的messageCallback_处理函数
 {
   loop_->assertInLoopThread();
+  if (edgeTriggered_)
+  {
+    handleReadEdgeTriggered(receiveTime);
+    return;
+  }
+  if (asyncIo_)
+  {
+    handleReadAsync(receiveTime);
+    return;
+  }
   int savedErrno = 0;
   // 事件可读, 自动读取channel_->fd()的数据到inputBuffer_中
+  bufferPool_->acquire(&inputBuffer_);
   ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
   if (n > 0)
   {
+    touchIdle();
     // messageCallback_是用户传入的数据读取函数, 基于当前inputBuffer_进行数据解析操作
     messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    bufferPool_->release(&inputBuffer_);  // 全部处理完才会归还
   }
   else if (n == 0) // 没有字节说明需要关闭连接
   {
@@ -329,18 +706,163 @@ void TcpConnection::handleRead(Timestamp receiveTime) // handleRead, Channel可
   }
 }
 
+// 边沿触发: 一直读到EAGAIN才会有下一次通知, 读到的数据合并成一次messageCallback_。
+// 用完预算时数据可能还没读完, 把剩下的排到任务队列, 先让本轮其他活跃连接处理
+void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime)
+{
+  if (state_ == kDisconnected || !channel_->isReading())  // 排队期间连接已关闭或者停止读
+  {
+    return;
+  }
+  int savedErrno = 0;
+  size_t total = 0;
+  ssize_t n = 0;
+  bufferPool_->acquire(&inputBuffer_);
+  while (total < kEdgeTriggeredBudget)
+  {
+    n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    if (n <= 0)
+    {
+      break;
+    }
+    total += static_cast<size_t>(n);
+  }
+  if (total > 0)
+  {
+    touchIdle();
+    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    bufferPool_->release(&inputBuffer_);
+  }
+  if (n > 0)
+  {
+    loop_->queueInLoop(std::bind(&TcpConnection::handleRead, shared_from_this(), receiveTime));
+  }
+  else if (n == 0)
+  {
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+      handleClose();
+    }
+  }
+  else if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK)
+  {
+    errno = savedErrno;
+    LOG_SYSERR << "TcpConnection::handleRead";
+    handleError();
+  }
+}
+
+// 异步读完成: 数据在poller的缓冲区中, 拷进inputBuffer_后交给messageCallback_, 然后提交下一次读
+void TcpConnection::handleReadAsync(Timestamp receiveTime)
+{
+  readInFlight_ = false;
+  if (state_ == kDisconnected)  // 连接已关闭, 读到的数据丢弃
+  {
+    finishAsyncIo();
+    return;
+  }
+  ssize_t n = channel_->asyncReadResult();
+  int savedErrno = 0;
+  if (n > 0)
+  {
+    bufferPool_->acquire(&inputBuffer_);
+    inputBuffer_.append(channel_->asyncReadData(), static_cast<size_t>(n));
+  }
+  else if (n == -ENOBUFS)  // poller本轮的读缓冲区用完了, 数据已经到了, 这次直接读
+  {
+    bufferPool_->acquire(&inputBuffer_);
+    n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+  }
+  else
+  {
+    savedErrno = static_cast<int>(-n);
+  }
+
+  if (n > 0)
+  {
+    touchIdle();
+    messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    bufferPool_->release(&inputBuffer_);
+  }
+  else if (n == 0)
+  {
+    handleClose();
+    return;
+  }
+  else if (savedErrno != ECANCELED && savedErrno != EAGAIN)  // ECANCELED: stopRead取消了这次读
+  {
+    errno = savedErrno;
+    LOG_SYSERR << "TcpConnection::handleRead";
+    handleClose();  // 错误已经由这次读取走了, 也不会再有poll报告的错误事件, 直接关闭
+    return;
+  }
+  submitAsyncRead();
+}
+
+void TcpConnection::submitAsyncRead()
+{
+  if (!readInFlight_ && reading_ && (state_ == kConnected || state_ == kDisconnecting))
+  {
+    loop_->asyncRead(channel_.get());
+    readInFlight_ = true;
+  }
+}
+
+bool TcpConnection::submitAsyncWrite()
+{
+  if (!asyncIov_)
+  {
+    asyncIov_.reset(new struct iovec[ChainBuffer::kMaxIovec]);
+  }
+  int count = outputBuffer_.peekMemory(asyncIov_.get(), ChainBuffer::kMaxIovec);
+  if (count == 0)
+  {
+    return false;
+  }
+  loop_->asyncWrite(channel_.get(), asyncIov_.get(), count);
+  writeInFlight_ = true;
+  return true;
+}
+
+void TcpConnection::finishAsyncIo()
+{
+  if (asyncGuard_ && !readInFlight_ && !writeInFlight_)
+  {
+    channel_->remove();
+    // 本次handleEvent返回后EventLoop还要访问channel, 放到任务队列里再析构
+    std::shared_ptr<TcpConnection> guard;
+    guard.swap(asyncGuard_);
+    loop_->queueInLoop([guard] {});
+  }
+}
+
 void TcpConnection::handleWrite() // Channel可写事件触发后会回调函数, (用户将数据写到了outputbuffer), 将outputbuffer数据发给对面
 {
   loop_->assertInLoopThread();
+  int result = 0;
+  if (asyncIo_ && channel_->takeAsyncWriteResult(&result))
+  {
+    handleWriteAsync(result);
+    return;
+  }
   if (channel_->isWriting())   // channel可写事件触发
   {
-    // 这里的sockets::write实际是从读索引后移
-    ssize_t n = sockets::write(channel_->fd(),
-                               outputBuffer_.peek(),
-                               outputBuffer_.readableBytes());  // 向channel->fd写入outputBuffer的数据, 位于peek(读索引处),大小为readableBytes
-    if (n > 0)
+    int savedErrno = 0;
+    size_t total = 0;
+    ssize_t n = 0;
+    // 用一次writev写出outputBuffer_的多个段, 已写完的段随即释放; 边沿触发时写到EAGAIN或者用完预算为止
+    do
     {
-      outputBuffer_.retrieve(n);  // 更新outputBuffer_读写索引
+      n = outputBuffer_.writeFd(channel_->fd(), &savedErrno, zeroCopyThreshold_);
+      if (n > 0)
+      {
+        total += static_cast<size_t>(n);
+      }
+    } while (edgeTriggered_ && n > 0 && outputBuffer_.readableBytes() > 0 && total < kEdgeTriggeredBudget);
+    if (total > 0)
+    {
+      touchIdle();
+      resumeReadIfDrained();
       if (outputBuffer_.readableBytes() == 0) // 没有可读的了
       {
         channel_->disableWriting(); // 设置channel不可写监听(因为已经写完了)
@@ -353,10 +875,19 @@ void TcpConnection::handleWrite() // Channel可写事件触发后会回调函数
           shutdownInLoop();
         }
       }
+      else if (edgeTriggered_ && n > 0)  // 预算用完而socket仍可写, 不会再有可写通知
+      {
+        loop_->queueInLoop(std::bind(&TcpConnection::handleWrite, shared_from_this()));
+      }
     }
-    else
+    if (n <= 0 && savedErrno != EWOULDBLOCK)  // sendInLoop直接调用时socket缓冲区可能已满
     {
+      errno = savedErrno;
       LOG_SYSERR << "TcpConnection::handleWrite";
+      if (savedErrno == EIO)  // sendFile的文件比声明的短, 对端收到的数据已不完整
+      {
+        forceCloseInLoop();
+      }
     }
   }
   else
@@ -366,6 +897,47 @@ void TcpConnection::handleWrite() // Channel可写事件触发后会回调函数
   }
 }
 
+// 异步写完成: 写完的部分直到现在才从outputBuffer_取走
+void TcpConnection::handleWriteAsync(int result)
+{
+  writeInFlight_ = false;
+  if (state_ == kDisconnected)
+  {
+    finishAsyncIo();
+    return;
+  }
+  if (result >= 0)
+  {
+    outputBuffer_.retrieve(static_cast<size_t>(result));
+    touchIdle();
+    resumeReadIfDrained();
+    if (outputBuffer_.readableBytes() == 0)
+    {
+      if (writeCompleteCallback_)
+      {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+      }
+      if (state_ == kDisconnecting)
+      {
+        shutdownInLoop();
+      }
+    }
+    else if (result == 0 || !submitAsyncWrite())
+    {
+      channel_->enableWriting();  // 文件段等可写事件后由handleWrite用sendfile发送
+    }
+  }
+  else if (result == -EAGAIN)  // 较老的内核对非阻塞socket的writev不等待
+  {
+    channel_->enableWriting();
+  }
+  else if (result != -ECANCELED)
+  {
+    errno = -result;
+    LOG_SYSERR << "TcpConnection::handleWrite";
+  }
+}
+
 void TcpConnection::handleClose() // 关闭连接的事件回调函数
 {
   loop_->assertInLoopThread();
@@ -384,8 +956,32 @@ void TcpConnection::handleClose() // 关闭连接的事件回调函数
 
 void TcpConnection::handleError() // 错误回调函数
 {
+  bool completions = (zeroCopyThreshold_ > 0 || outputBuffer_.zeroCopyPending() > 0)
+                     && handleZeroCopyCompletions();
   int err = sockets::getSocketError(channel_->fd());
-  LOG_ERROR << "TcpConnection::handleError [" << name_
+  if (completions && err == 0)  // 只是MSG_ZEROCOPY的完成通知
+  {
+    return;
+  }
+  LOG_ERROR << "TcpConnection::handleError [" << name()
             << "] - SO_ERROR = " << err << " " << strerror_tl(err);
 }
 
+// MSG_ZEROCOPY的完成通知在错误队列中, 以POLLERR报告; 读空队列并释放内核已不再引用的数据
+bool TcpConnection::handleZeroCopyCompletions()
+{
+  bool any = false;
+  uint32_t lo = 0;
+  uint32_t hi = 0;
+  int ret = 0;
+  while ((ret = sockets::recvZeroCopyCompletion(channel_->fd(), &lo, &hi)) != 0)
+  {
+    if (ret > 0)
+    {
+      outputBuffer_.releaseZeroCopy(lo, hi);
+      any = true;
+    }
+  }
+  return any;
+}
+
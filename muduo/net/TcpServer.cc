@@ -1,25 +1,85 @@
 #include "muduo/net/TcpServer.h"
 
+#include "muduo/base/CountDownLatch.h"
 #include "muduo/base/Logging.h"
 #include "muduo/net/Acceptor.h"
 #include "muduo/net/EventLoop.h"
 #include "muduo/net/EventLoopThreadPool.h"
+#include "muduo/net/IdleWheel.h"
 #include "muduo/net/SocketsOps.h"
 
-#include <stdio.h>  // snprintf
+#include <string.h>
 
 using namespace muduo;
 using namespace muduo::net;
 
+namespace
+{
+
+// murmur3的finalizer, 地址的各位都影响低位, 取模后才分散
+uint64_t mix64(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/// 只用IP不用端口, 同一个客户端的多个连接落在同一个loop
+size_t hashPeerIp(const InetAddress& peerAddr)
+{
+  const struct sockaddr* addr = peerAddr.getSockAddr();
+  if (addr->sa_family == AF_INET6)
+  {
+    uint64_t words[2];
+    memcpy(words, &sockets::sockaddr_in6_cast(addr)->sin6_addr, sizeof words);
+    return static_cast<size_t>(mix64(words[0] ^ mix64(words[1])));
+  }
+  return static_cast<size_t>(mix64(peerAddr.ipv4NetEndian()));
+}
+
+}  // namespace
+
+/// 一个IO loop上的连接表分片, kReusePortPerLoop模式下还有该loop独占的监听socket。
+/// 除启动和析构外只在该loop线程访问, 连接的登记和移除都不离开所属线程
+struct TcpServer::LoopShard
+{
+  LoopShard(EventLoop* ioLoop, uint64_t firstConnId)
+    : loop(ioLoop),
+      nextConnId(firstConnId)
+  {
+  }
+
+  EventLoop* loop;
+  std::unique_ptr<Acceptor> acceptor;  // 只在kReusePortPerLoop模式下有
+  std::unique_ptr<IdleWheel> idleWheel;  // 只在设置了空闲超时时有
+  uint64_t nextConnId;  // kReusePortPerLoop模式下第i个loop分配i+1, i+1+n, i+1+2n..., 各loop之间不需要同步也不会重复
+  ConnectionMap connections;
+};
+
 // TcpServer主要包含, 一个loop主循环, 一个acceptor接受连接, 一个线程池threadPool分配, 若干tcpConnection通信连接, 一些用户设置的回调函数注册到tcpConnection中
 TcpServer::TcpServer(EventLoop* loop,
                      const InetAddress& listenAddr,
                      const string& nameArg,
                      Option option)
   : loop_(loop),  // tcpserver的主loop
+    listenAddr_(listenAddr),
     ipPort_(listenAddr.toIpPort()),
     name_(nameArg),
-    acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)), // 初始化acceptor对象监听socket,(调用listen(才开始监听)
+    connNamePrefix_(std::make_shared<const string>(nameArg + "-" + ipPort_ + "#")),
+    reusePortPerLoop_(option == kReusePortPerLoop),
+    reusePortCpuSteering_(false),
+    edgeTriggered_(false),
+    autoCork_(false),
+    idleTimeout_(0),
+    backpressureHigh_(0),
+    backpressureLow_(0),
+    busyPollUs_(0),
+    socketBusyPollUs_(0),
+    // 初始化acceptor对象监听socket,(调用listen(才开始监听); kReusePortPerLoop模式下在start()时为每个IO loop各建一个
+    acceptor_(reusePortPerLoop_ ? NULL : new Acceptor(loop, listenAddr, option == kReusePort)),
     threadPool_(new EventLoopThreadPool(loop, name_)),     // 构造threadPool对象
     /// 初始化connection回调函数和message回调函数
     connectionCallback_(defaultConnectionCallback),
@@ -27,8 +87,11 @@ TcpServer::TcpServer(EventLoop* loop,
     nextConnId_(1)
 {
   // 设置acceptor_的连接回调函数, 在handleread()中调用
-  acceptor_->setNewConnectionCallback(
-      std::bind(&TcpServer::newConnection, this, _1, _2)); // 新连接一旦到达, 自动回调TcpServer::newConnection封装为connection
+  if (acceptor_)
+  {
+    acceptor_->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnection, this, _1, _2)); // 新连接一旦到达, 自动回调TcpServer::newConnection封装为connection
+  }
 }
 
 TcpServer::~TcpServer()
@@ -36,13 +99,29 @@ TcpServer::~TcpServer()
   loop_->assertInLoopThread();
   LOG_TRACE << "TcpServer::~TcpServer [" << name_ << "] destructing";
 
-  for (auto& item : connections_) // 每一个TcpConnection, 一个server可用有多个tcpConnection
+  // 连接表和监听socket属于各自的IO loop, 在其线程中销毁, 等待完成后线程池才能退出
+  for (auto& item : shards_)
+  {
+    CountDownLatch latch(1);
+    item->loop->runInLoop(
+        std::bind(&TcpServer::destroyShard, this, get_pointer(item), &latch));
+    latch.wait();
+  }
+}
+
+void TcpServer::destroyShard(LoopShard* shard, CountDownLatch* latch)
+{
+  shard->loop->assertInLoopThread();
+  shard->acceptor.reset();
+  shard->idleWheel.reset();  // 要在连接销毁之前, 时间轮里是连接的裸指针
+  for (auto& item : shard->connections)
   {
     TcpConnectionPtr conn(item.second);
     item.second.reset();
-    conn->getLoop()->runInLoop(
-      std::bind(&TcpConnection::connectDestroyed, conn));
+    conn->connectDestroyed();
   }
+  shard->connections.clear();
+  latch->countDown();
 }
 
 void TcpServer::setThreadNum(int numThreads)
@@ -51,67 +130,173 @@ void TcpServer::setThreadNum(int numThreads)
   threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setThreadNum(int numThreads, const std::vector<int>& cpus)
+{
+  setThreadNum(numThreads);
+  threadPool_->setThreadCpus(cpus);
+}
+
+void TcpServer::setOneLoopPerCore()
+{
+  threadPool_->setOneLoopPerCore();
+}
+
 void TcpServer::start() // server创建线程池loop, 运行监听
 {
   if (started_.getAndSet(1) == 0)
   { 
     threadPool_->start(threadInitCallback_); // 线程池启动, 结果是创建若干线程, 每个线程创建loop对象, 子线程执行loop()阻塞到里poll中
+    startShards();
+    if (reusePortPerLoop_)
+    {
+      return;
+    }
     assert(!acceptor_->listening());
     loop_->runInLoop(
         std::bind(&Acceptor::listen, get_pointer(acceptor_)));  // 主线程运行&Acceptor::listen监听, 新连接到来会调用&TcpServer::newConnection创建TcpConnection对象
   }
 }
 
+void TcpServer::startShards()
+{
+  std::vector<EventLoop*> loops = threadPool_->getAllLoops();  // 没有IO线程时就是主loop
+  const int numLoops = static_cast<int>(loops.size());
+  for (int i = 0; i < numLoops; ++i)
+  {
+    shards_.emplace_back(new LoopShard(loops[i], i + 1));
+    if (idleTimeout_ > 0)
+    {
+      shards_.back()->idleWheel.reset(new IdleWheel(loops[i], idleTimeout_));
+    }
+    if (busyPollUs_ > 0)
+    {
+      loops[i]->setBusyPoll(busyPollUs_);
+    }
+  }
+  if (!reusePortPerLoop_)
+  {
+    return;
+  }
+  for (auto& item : shards_)
+  {
+    item->acceptor.reset(new Acceptor(item->loop, listenAddr_, true));
+    item->acceptor->setNewConnectionCallback(
+        std::bind(&TcpServer::newConnectionInLoop, this, get_pointer(item), _1, _2));
+  }
+  // 逐个等待listen完成, 使socket在SO_REUSEPORT组中的序号与loop下标一致, CPU steering依赖这个顺序
+  for (auto& item : shards_)
+  {
+    CountDownLatch latch(1);
+    Acceptor* acceptor = get_pointer(item->acceptor);
+    item->loop->runInLoop([acceptor, &latch] {
+      acceptor->listen();
+      latch.countDown();
+    });
+    latch.wait();
+  }
+  if (reusePortCpuSteering_ && numLoops > 1)
+  {
+    const std::vector<int>& cpus = threadPool_->threadCpus();
+    if (cpus.size() >= shards_.size())
+    {
+      shards_.front()->acceptor->attachReusePortCpuFilter(
+          std::vector<int>(cpus.begin(), cpus.begin() + numLoops));
+    }
+    else
+    {
+      shards_.front()->acceptor->attachReusePortCpuFilter(numLoops);
+    }
+  }
+}
+
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)  // 新连接到来会调用该函数, 基于sockfd
 {
   loop_->assertInLoopThread();   // 这个loop_是主线程的, 主线程执行
   // 这里根本不用处理线程池, 而是直接分配一个ioLoop指针, 就可以让对应的子线程自动处理对象
-  EventLoop* ioLoop = threadPool_->getNextLoop(); // 从线程池中找到一个可用的ioLoop, 这个ioLoop指向的loop对象在子线程里, 子线程还阻塞在eventloop的epoll_wait
-  char buf[64];
-  snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);  
-  ++nextConnId_;
-  string connName = name_ + buf;  // 创建connName
-
-  LOG_INFO << "TcpServer::newConnection [" << name_
-           << "] - new connection [" << connName
-           << "] from " << peerAddr.toIpPort();
+  EventLoop* ioLoop = threadPool_->selectLoop(hashPeerIp(peerAddr)); // 按策略从线程池中找到一个ioLoop, 这个ioLoop指向的loop对象在子线程里, 子线程还阻塞在eventloop的epoll_wait
+  LoopShard* shard = NULL;
+  for (auto& item : shards_)  // loop数量很少, 线性查找即可
+  {
+    if (item->loop == ioLoop)
+    {
+      shard = get_pointer(item);
+      break;
+    }
+  }
+  assert(shard != NULL);
+
+  TcpConnectionPtr conn = createConnection(shard, nextConnId_++, sockfd, peerAddr);
+  // master线程将到来的连接封装成对象, 并将该连接执行权交给线程池的线程。
+  // 方法是将登记和TcpConnection::connectEstablished放入指定线程的工作队列, 唤醒该线程, 使线程执行这一方法
+  ioLoop->runInLoop(std::bind(&TcpServer::establishInLoop, this, shard, conn));
+}
+
+void TcpServer::newConnectionInLoop(LoopShard* shard, int sockfd, const InetAddress& peerAddr)
+{
+  shard->loop->assertInLoopThread();  // accept和处理连接在同一个IO线程, 没有跨线程投递
+  uint64_t connId = shard->nextConnId;
+  shard->nextConnId += shards_.size();
+  establishInLoop(shard, createConnection(shard, connId, sockfd, peerAddr));
+}
+
+TcpConnectionPtr TcpServer::createConnection(LoopShard* shard,
+                                             uint64_t connId,
+                                             int sockfd,
+                                             const InetAddress& peerAddr)
+{
   InetAddress localAddr(sockets::getLocalAddr(sockfd));   // 封装IP地址
 
-  TcpConnectionPtr conn(new TcpConnection(ioLoop,
-                                          connName,
+  TcpConnectionPtr conn(new TcpConnection(shard->loop,
+                                          connNamePrefix_,
+                                          connId,
                                           sockfd,
                                           localAddr,
                                           peerAddr)); // 来了一个连接就创建一个TcpConnection,用子线程的loop指针, 该对象用shared_ptr维护
-  
-  // 设置好TcpConnection的回调函数, 这些回调函数来自于用户编写的逻辑
-  connections_[connName] = conn;  // coonection name->conn的map
+  // 每个连接都打日志, 放在DEBUG级别; 只记编号, 不去生成连接名
+  LOG_DEBUG << "TcpServer::newConnection [" << name_
+            << "] - new connection #" << connId
+            << " from " << peerAddr.toIpPort();
 
+  // 设置好TcpConnection的回调函数, 这些回调函数来自于用户编写的逻辑
   conn->setConnectionCallback(connectionCallback_); // 设置tcpconnection的连接回调函数, 来自用户自定义。以下同样
   conn->setMessageCallback(messageCallback_);
   conn->setWriteCompleteCallback(writeCompleteCallback_);
   conn->setCloseCallback(
-      std::bind(&TcpServer::removeConnection, this, _1));
-
-  // master线程将到来的连接封装成对象, 持有指针, 并将该连接执行权交给线程池的线程。
-  // 方法是将TcpConnection::connectEstablished放入指定线程的工作队列, 唤醒该线程, 使线程执行这一方法
-  ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn)); 
+      std::bind(&TcpServer::removeConnection, this, shard, _1));
+  conn->setEdgeTriggered(edgeTriggered_);
+  conn->setAutoCork(autoCork_);
+  conn->setReadBackpressure(backpressureHigh_, backpressureLow_);
+  if (socketBusyPollUs_ > 0)
+  {
+    conn->setBusyPoll(socketBusyPollUs_);
+  }
+  return conn;
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr& conn)
+void TcpServer::establishInLoop(LoopShard* shard, const TcpConnectionPtr& conn)
 {
-  loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));  // tcpserver移除该连接
+  shard->loop->assertInLoopThread();
+  shard->connections[conn->id()] = conn;
+  if (shard->idleWheel)
+  {
+    shard->idleWheel->add(get_pointer(conn));
+  }
+  conn->connectEstablished();
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
+void TcpServer::removeConnection(LoopShard* shard, const TcpConnectionPtr& conn)
 {
-  loop_->assertInLoopThread();
-  LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_
-           << "] - connection " << conn->name();  
-  size_t n = connections_.erase(conn->name());  // tcpconnection从tcpserver的连接map中擦除
+  shard->loop->assertInLoopThread();  // close回调就在连接所属的loop中执行, 不用回到主loop
+  LOG_DEBUG << "TcpServer::removeConnection [" << name_
+            << "] - connection #" << conn->id()
+            << " from " << conn->peerAddress().toIpPort();
+  size_t n = shard->connections.erase(conn->id());  // tcpconnection从所在分片的连接表中擦除
   (void)n;
   assert(n == 1);
-  EventLoop* ioLoop = conn->getLoop();  // tcpconnection所属的loop
-  ioLoop->queueInLoop(
+  if (shard->idleWheel)
+  {
+    shard->idleWheel->remove(get_pointer(conn));
+  }
+  shard->loop->queueInLoop(
       std::bind(&TcpConnection::connectDestroyed, conn)); // 在loop所属的线程中执行&TcpConnection::connectDestroyed关闭tcpconnection
 }
-
@@ -11,13 +11,12 @@
 #ifndef MUDUO_NET_TIMERQUEUE_H_
 #define MUDUO_NET_TIMERQUEUE_H_
 
-#include <set>
 #include <vector>
 
-#include "muduo/base/Mutex.h"
 #include "muduo/base/Timestamp.h"
 #include "muduo/net/Callbacks.h"
 #include "muduo/net/Channel.h"
+#include "muduo/net/TimingWheel.h"
 
 namespace muduo
 {
@@ -33,46 +32,44 @@ class TimerId;
 /// No guarantee that the callback will be on time.
 /// 定时器队列
 ///
+/// 定时器放在分层时间轮(TimingWheel)中, 插入和取消都是O(1);
+/// 精度为一个tick(1ms), 同一tick到期的定时器一次timerfd唤醒批量执行。
+/// Timer节点在loop线程内池化复用, 节点内存直到TimerQueue析构才释放,
+/// 因此过期的TimerId仍可以安全地用sequence比对。
+/// 定时时刻都是单调时钟(Timestamp::monotonicNow())的, 修改系统时间不影响定时器。
+///
 class TimerQueue : noncopyable
 {
  public:
   explicit TimerQueue(EventLoop* loop);   // 只能用eventloop指针显示构造
   ~TimerQueue();
 
-  TimerId addTimer(TimerCallback cb, Timestamp when, double interval);  // 将cb, when, interval增加定时任务
+  TimerId addTimer(TimerCallback cb, Timestamp when, double interval);  // 将cb, when(单调时钟), interval增加定时任务
 
   void cancel(TimerId timerId); // 根据timerId取消定时任务
 
  private:
-
-  typedef std::pair<Timestamp, Timer*> Entry; // Entry是pair<Timestamp, Timer*>, 时间戳和Timer*指针
-
-  typedef std::set<Entry> TimerList;  // 用set保存TimerList定时任务列表, set默认定时任务根据时间戳从小到大排列
-
-  typedef std::pair<Timer*, int64_t> ActiveTimer; // 活跃的定时任务, pair<Timer*, int64_t>, Timer指针。可以通过timerId构造
-  typedef std::set<ActiveTimer> ActiveTimerSet; // 活跃定时任务的集合, 根据Timer*地址从小到大排列
-
   void addTimerInLoop(Timer* timer);  // 将Timer加入到loop
   void cancelInLoop(TimerId timerId);
   // called when timerfd alarms
   void handleRead();  // timerfd可读的回调函数
-  // move out all expired timers
-  /// 得到超期的定时事件
-  std::vector<Entry> getExpired(Timestamp now); // 根据时间找到超时的定时事件, 返回列表
-  void reset(const std::vector<Entry>& expired, Timestamp now);
+  void reset(Timestamp now);  // 重新加入需要重复的定时器, 其余放回池中
+
+  /// 按时间轮下一个需要处理的tick设置timerfd, 只在变早时才调用timerfd_settime
+  void rearm();
 
-  /// 插入timer
-  bool insert(Timer* timer);
+  Timer* allocTimer(TimerCallback cb, Timestamp when, double interval);
+  void releaseTimer(Timer* timer);
 
   EventLoop* loop_; // 定时器所在的loop对象
   const int timerfd_; // 用于定时的timerfd
   Channel timerfdChannel_;  // 定时的监听通道
-  TimerList timers_;  // 时间戳, 定时任务的列表, 根据时间戳排序
+  TimingWheel wheel_;  // 未到期的定时器
+  int64_t armedTick_;  // timerfd当前设置的tick, -1表示没有设置
 
-  // for cancel()
-  ActiveTimerSet activeTimers_;
+  std::vector<Timer*> expired_;  // 本次到期的定时器, 复用避免每次分配
+  std::vector<Timer*> freeTimers_;  // Timer节点池, 只在loop线程访问
   bool callingExpiredTimers_; /* atomic */
-  ActiveTimerSet cancelingTimers_;
 };
 
 }  // namespace net
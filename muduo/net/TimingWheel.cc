@@ -0,0 +1,229 @@
+#include "muduo/net/TimingWheel.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "muduo/net/Timer.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+namespace
+{
+
+const int64_t kMaxSpan = static_cast<int64_t>(1) << (TimingWheel::kLevels * TimingWheel::kLevelBits);
+const int kSlotMask = TimingWheel::kSlots - 1;
+
+/// 循环右移, 使位图从当前槽开始数
+inline uint64_t rotateRight(uint64_t bits, int n)
+{
+  return n == 0 ? bits : (bits >> n) | (bits << (64 - n));
+}
+
+}  // namespace
+
+TimingWheel::TimingWheel(int64_t currentTick)
+  : currentTick_(currentTick),
+    size_(0)
+{
+  memset(slots_, 0, sizeof slots_);
+  memset(occupied_, 0, sizeof occupied_);
+}
+
+void TimingWheel::add(Timer* timer)
+{
+  assert(!timer->inWheel());
+  timer->tick_ = toTick(timer->expiration());
+  link(timer);
+  ++size_;
+}
+
+void TimingWheel::remove(Timer* timer)
+{
+  assert(timer->inWheel());
+  unlink(timer);
+  --size_;
+}
+
+void TimingWheel::advance(int64_t nowTick, std::vector<Timer*>* expired)
+{
+  while (currentTick_ <= nowTick)
+  {
+    // 直接跳到下一个有事可做的tick, 中间的空槽不用逐个走
+    int64_t next = nextTick();
+    if (next < 0 || next > nowTick)
+    {
+      currentTick_ = nowTick + 1;
+      break;
+    }
+    currentTick_ = next;
+
+    // 低层转完一圈, 把上一层对应的槽分配下来
+    for (int level = 1; level < kLevels; ++level)
+    {
+      int shift = level * kLevelBits;
+      if ((currentTick_ & ((static_cast<int64_t>(1) << shift) - 1)) != 0)
+      {
+        break;
+      }
+      cascade(level, static_cast<int>((currentTick_ >> shift) & kSlotMask));
+    }
+
+    const int64_t tick = currentTick_;
+    Timer* timer = takeSlot(0, static_cast<int>(tick & kSlotMask));
+    ++currentTick_;
+    while (timer)
+    {
+      Timer* nextTimer = timer->next_;
+      timer->prev_ = NULL;
+      timer->next_ = NULL;
+      if (timer->tick_ <= tick)
+      {
+        --size_;
+        expired->push_back(timer);
+      }
+      else
+      {
+        link(timer);  // 超出时间轮范围被截断的定时器, 重新放回
+      }
+      timer = nextTimer;
+    }
+  }
+}
+
+int64_t TimingWheel::nextTick() const
+{
+  if (size_ == 0)
+  {
+    return -1;
+  }
+  int64_t earliest = -1;
+  for (int level = 0; level < kLevels; ++level)
+  {
+    uint64_t bits = occupied_[level];
+    if (bits == 0)
+    {
+      continue;
+    }
+    // 第level层的槽只在tick为2^shift的整数倍时处理, 从不早于currentTick_的第一个边界开始数
+    int shift = level * kLevelBits;
+    int64_t span = static_cast<int64_t>(1) << shift;
+    int64_t base = (currentTick_ + span - 1) >> shift << shift;
+    int index = static_cast<int>((base >> shift) & kSlotMask);
+    int distance = __builtin_ctzll(rotateRight(bits, index));
+    int64_t tick = base + (static_cast<int64_t>(distance) << shift);
+    if (earliest < 0 || tick < earliest)
+    {
+      earliest = tick;
+    }
+  }
+  return earliest;
+}
+
+void TimingWheel::catchUp(int64_t nowTick)
+{
+  if (size_ == 0 && nowTick > currentTick_)
+  {
+    currentTick_ = nowTick;
+  }
+}
+
+void TimingWheel::takeAll(std::vector<Timer*>* timers)
+{
+  for (int level = 0; level < kLevels; ++level)
+  {
+    for (int index = 0; index < kSlots; ++index)
+    {
+      Timer* timer = takeSlot(level, index);
+      while (timer)
+      {
+        Timer* nextTimer = timer->next_;
+        timer->prev_ = NULL;
+        timer->next_ = NULL;
+        timers->push_back(timer);
+        timer = nextTimer;
+      }
+    }
+  }
+  size_ = 0;
+}
+
+void TimingWheel::link(Timer* timer)
+{
+  // 已经过期的放到当前tick, 太远的先放在最高层, cascade时再往下放
+  int64_t tick = timer->tick_;
+  if (tick < currentTick_)
+  {
+    tick = currentTick_;
+  }
+  else if (tick - currentTick_ >= kMaxSpan)
+  {
+    tick = currentTick_ + kMaxSpan - 1;
+  }
+  int64_t distance = tick - currentTick_;
+  int level = distance < kSlots ? 0 : (63 - __builtin_clzll(static_cast<uint64_t>(distance))) / kLevelBits;
+  int index = static_cast<int>((tick >> (level * kLevelBits)) & kSlotMask);
+
+  Timer** slot = &slots_[level][index];
+  timer->prev_ = NULL;
+  timer->next_ = *slot;
+  if (*slot)
+  {
+    (*slot)->prev_ = timer;
+  }
+  *slot = timer;
+  timer->slot_ = slot;
+  occupied_[level] |= static_cast<uint64_t>(1) << index;
+}
+
+void TimingWheel::unlink(Timer* timer)
+{
+  Timer** slot = timer->slot_;
+  if (timer->prev_)
+  {
+    timer->prev_->next_ = timer->next_;
+  }
+  else
+  {
+    *slot = timer->next_;
+  }
+  if (timer->next_)
+  {
+    timer->next_->prev_ = timer->prev_;
+  }
+  if (*slot == NULL)
+  {
+    ptrdiff_t offset = slot - &slots_[0][0];
+    occupied_[offset / kSlots] &= ~(static_cast<uint64_t>(1) << (offset % kSlots));
+  }
+  timer->prev_ = NULL;
+  timer->next_ = NULL;
+  timer->slot_ = NULL;
+}
+
+void TimingWheel::cascade(int level, int index)
+{
+  Timer* timer = takeSlot(level, index);
+  while (timer)
+  {
+    Timer* nextTimer = timer->next_;
+    link(timer);
+    timer = nextTimer;
+  }
+}
+
+Timer* TimingWheel::takeSlot(int level, int index)
+{
+  Timer* head = slots_[level][index];
+  if (head == NULL)
+  {
+    return NULL;
+  }
+  slots_[level][index] = NULL;
+  occupied_[level] &= ~(static_cast<uint64_t>(1) << index);
+  for (Timer* timer = head; timer; timer = timer->next_)
+  {
+    timer->slot_ = NULL;
+  }
+  return head;
+}
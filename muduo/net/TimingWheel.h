@@ -0,0 +1,93 @@
+// Use of this source code is governed by a BSD-style license
+// that can be found in the License file.
+//
+// This is an internal header file, you should not include this.
+
+#ifndef MUDUO_NET_TIMINGWHEEL_H_
+#define MUDUO_NET_TIMINGWHEEL_H_
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "muduo/base/Timestamp.h"
+#include "muduo/base/noncopyable.h"
+
+namespace muduo
+{
+namespace net
+{
+
+class Timer;
+
+///
+/// Hierarchical timing wheel.
+/// 分层时间轮, 插入和删除都是O(1)
+///
+/// 时间被切成kTickMicroSeconds的tick, 共kLevels层, 每层kSlots个槽,
+/// 第L层的一个槽覆盖kSlots^L个tick。定时器按到期tick与当前tick的距离放入对应层,
+/// 低层转完一圈时把上一层的一个槽重新分配(cascade)到下面各层。
+/// 同一个tick到期的定时器在同一个槽里, 一次取出, 由TimerQueue批量执行。
+/// 只能在所属loop线程中使用。
+///
+class TimingWheel : noncopyable
+{
+ public:
+  static const int64_t kTickMicroSeconds = 1000;  // 1ms精度
+  static const int kLevelBits = 6;
+  static const int kSlots = 1 << kLevelBits;
+  static const int kLevels = 6;  // 覆盖2^36个tick, 约两年
+
+  explicit TimingWheel(int64_t currentTick);
+
+  void add(Timer* timer);
+  void remove(Timer* timer);
+
+  /// 处理到nowTick(含)为止的所有tick, 到期的定时器追加到expired, 已从时间轮中摘除
+  void advance(int64_t nowTick, std::vector<Timer*>* expired);
+
+  /// 下一个需要处理的tick(定时器到期或者需要cascade), 没有定时器返回-1
+  int64_t nextTick() const;
+
+  /// 时间轮为空时把当前tick推进到nowTick, 避免长时间空闲后新定时器放到过高的层
+  void catchUp(int64_t nowTick);
+
+  /// 摘除全部定时器, 析构时使用
+  void takeAll(std::vector<Timer*>* timers);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  int64_t currentTick() const { return currentTick_; }
+
+  /// 定时时刻向上取整到tick, 保证不会提前触发
+  static int64_t toTick(Timestamp when)
+  {
+    return (when.microSecondsSinceEpoch() + kTickMicroSeconds - 1) / kTickMicroSeconds;
+  }
+
+  /// 当前时刻向下取整到tick
+  static int64_t nowTick(Timestamp now)
+  {
+    return now.microSecondsSinceEpoch() / kTickMicroSeconds;
+  }
+
+  static Timestamp tickTime(int64_t tick)
+  {
+    return Timestamp(tick * kTickMicroSeconds);
+  }
+
+ private:
+  void link(Timer* timer);
+  void unlink(Timer* timer);
+  void cascade(int level, int index);
+  Timer* takeSlot(int level, int index);
+
+  int64_t currentTick_;  // 下一个要处理的tick
+  size_t size_;
+  Timer* slots_[kLevels][kSlots];  // 每个槽是双向链表的头
+  uint64_t occupied_[kLevels];  // 每层非空槽的位图
+};
+
+}  // namespace net
+}  // namespace muduo
+#endif  // MUDUO_NET_TIMINGWHEEL_H_
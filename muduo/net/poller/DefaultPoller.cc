@@ -9,17 +9,33 @@
 #include "muduo/net/Poller.h"
 #include "muduo/net/poller/PollPoller.h"
 #include "muduo/net/poller/EPollPoller.h"
+#include "muduo/net/poller/IoUringPoller.h"
+
+#include "muduo/base/Logging.h"
 
 #include <stdlib.h>
 
 using namespace muduo::net;
 
+// 环境变量选择poller, 默认epoll:
+//   MUDUO_USE_POLL   poll(2)
+//   MUDUO_USE_URING  io_uring, TcpConnection的读写也异步提交(RECV/WRITEV), 和等待合并成每轮一次io_uring_enter;
+//                    内核不支持时回退到epoll
 Poller* Poller::newDefaultPoller(EventLoop* loop)
 {
   if (::getenv("MUDUO_USE_POLL"))
   {
     return new PollPoller(loop);
   }
+  else if (::getenv("MUDUO_USE_URING"))
+  {
+    if (IoUringPoller::available())
+    {
+      return new IoUringPoller(loop);
+    }
+    LOG_WARN << "io_uring is not available, fall back to epoll";
+    return new EPollPoller(loop);
+  }
   else
   {
     return new EPollPoller(loop);
@@ -12,7 +12,7 @@
 using namespace muduo;
 using namespace muduo::net;
 
-// EPollPoller, 维护一个map(fd, channel), updateChannel先处理map信息, 再调用update处理epoll维护fd 数据结构中的信息
+// EPollPoller, 维护一个fd下标的表(fd, channel), updateChannel先处理表中信息, 再调用update处理epoll维护fd 数据结构中的信息
 
 // On Linux, the constants of poll(2) and epoll(4)
 // are expected to be the same.
@@ -63,6 +63,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList* activeChannels)
     LOG_TRACE << numEvents << " events happened";
     fillActiveChannels(numEvents, activeChannels);  // 将已经得到的活跃fd封装到avtiveChannels, 活跃事件已经外语events_中了
     
+    // events_只增不减, activeChannels由EventLoop每轮clear()复用, 稳定后poll不再分配内存
     if (implicit_cast<size_t>(numEvents) == events_.size())
     {
       events_.resize(events_.size()*2);
@@ -113,13 +114,12 @@ void EPollPoller::updateChannel(Channel* channel) // 根据传入的channel, 在
     int fd = channel->fd(); 
     if (index == kNew)
     {
-      assert(channels_.find(fd) == channels_.end());
-      channels_[fd] = channel;  // 将pair(fd, channel)对加入到channels_中
+      assert(channels_.find(fd) == NULL);
+      channels_.insert(fd, channel);  // 将pair(fd, channel)对加入到channels_中
     }
     else // index == kDeleted
     {
-      assert(channels_.find(fd) != channels_.end());  // 保证pair(fd, channel)必须已经存在于channels中
-      assert(channels_[fd] == channel);
+      assert(channels_.find(fd) == channel);  // 保证pair(fd, channel)必须已经存在于channels中
     }
     channel->set_index(kAdded); // channel操作信息
 
@@ -131,8 +131,7 @@ void EPollPoller::updateChannel(Channel* channel) // 根据传入的channel, 在
     // update existing one with EPOLL_CTL_MOD/DEL
     int fd = channel->fd();
     (void)fd; // 防止报没有使用变量的警告
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
+    assert(channels_.find(fd) == channel);
     assert(index == kAdded);
     if (channel->isNoneEvent())   // channel没有事件信息 
     {
@@ -146,19 +145,18 @@ void EPollPoller::updateChannel(Channel* channel) // 根据传入的channel, 在
   }
 }
 
-/// 在channelmap中删除关联
+/// 在channels_表中删除关联
 void EPollPoller::removeChannel(Channel* channel)
 {
   Poller::assertInLoopThread(); // 必须在所属loop所在的线程空间的线程执行
   int fd = channel->fd();
   LOG_TRACE << "fd = " << fd;
-  assert(channels_.find(fd) != channels_.end());
-  assert(channels_[fd] == channel);
+  assert(channels_.find(fd) == channel);
   assert(channel->isNoneEvent());
   int index = channel->index();
   assert(index == kAdded || index == kDeleted); // index只能为kadd或kdelete
 
-  size_t n = channels_.erase(fd); // 从channels_ map删除fd对
+  size_t n = channels_.erase(fd); // 从channels_表中删除fd
   (void)n;
   assert(n == 1);
   if (index == kAdded)
@@ -174,7 +172,11 @@ void EPollPoller::update(int operation, Channel* channel) // 根据operation(EPO
   memZero(&event, sizeof event);  // event清零
 
   /// 事件元素, 设置event.events, event.data.ptr
-  event.events = channel->events(); // 设置event的events
+  event.events = channel->pollEvents(); // 设置event的events
+  if (channel->edgeTriggered())
+  {
+    event.events |= EPOLLET;
+  }
   event.data.ptr = channel; // 设置event.data.ptr
   int fd = channel->fd();
   LOG_TRACE << "epoll_ctl op = " << operationToString(operation)
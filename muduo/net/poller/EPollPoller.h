@@ -24,6 +24,7 @@ class EPollPoller : public Poller
   Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;  // 重写poll
   void updateChannel(Channel* channel) override;
   void removeChannel(Channel* channel) override;
+  bool supportsEdgeTriggered() const override { return true; }
 
  private:
   static const int kInitEventListSize = 16;
@@ -0,0 +1,556 @@
+#include "muduo/net/poller/IoUringPoller.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "muduo/base/Logging.h"
+#include "muduo/net/Channel.h"
+
+using namespace muduo;
+using namespace muduo::net;
+
+// IoUringPoller, 不依赖liburing, 直接用io_uring_setup/io_uring_enter系统调用和mmap的共享环形队列
+// user_data高32位是fd, 第31-30位是操作类型, 低30位是poll注册时的generation
+
+namespace
+{
+const int kNew = -1;
+const int kAdded = 1;
+
+const uint64_t kCancelTag = ~static_cast<uint64_t>(0);  // POLL_REMOVE/ASYNC_CANCEL/PROVIDE_BUFFERS自身的完成事件
+
+const uint32_t kOpPoll = 0;
+const uint32_t kOpRead = 1;
+const uint32_t kOpWrite = 2;
+const uint32_t kGenerationMask = (1u << 30) - 1;
+
+const uint16_t kBufferGroup = 0;
+
+int ioUringSetup(unsigned entries, struct io_uring_params* params)
+{
+  return static_cast<int>(::syscall(SYS_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete,
+                 unsigned flags, const void* arg, size_t argSize)
+{
+  return static_cast<int>(::syscall(SYS_io_uring_enter, ringFd, toSubmit,
+                                    minComplete, flags, arg, argSize));
+}
+
+#pragma GCC diagnostic ignored "-Wold-style-cast"
+bool mmapFailed(void* addr)
+{
+  return addr == MAP_FAILED;
+}
+#pragma GCC diagnostic error "-Wold-style-cast"
+
+template<typename T>
+T* ringPtr(void* ring, uint32_t offset)
+{
+  return static_cast<T*>(static_cast<void*>(static_cast<char*>(ring) + offset));
+}
+
+uint64_t makeUserData(int fd, uint32_t op, uint32_t generation)
+{
+  return (static_cast<uint64_t>(fd) << 32) | (op << 30) | (generation & kGenerationMask);
+}
+
+// 异步读写的channel只为文件段等待可写, 可读由异步读代替
+int pollEventsOf(const Channel* channel)
+{
+  return channel->asyncIo() ? (channel->events() & POLLOUT) : channel->events();
+}
+
+}  // namespace
+
+bool IoUringPoller::available()
+{
+#ifdef IORING_FEAT_EXT_ARG
+  static const bool ok = [] {
+    struct io_uring_params params;
+    memZero(&params, sizeof params);
+    int fd = ioUringSetup(2, &params);  // 被seccomp禁止或内核太老时失败
+    if (fd < 0)
+    {
+      return false;
+    }
+    ::close(fd);
+    return (params.features & IORING_FEAT_EXT_ARG) != 0;
+  }();
+  return ok;
+#else
+  return false;
+#endif
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+  : Poller(loop),
+    ringFd_(-1),
+    sqRing_(NULL),
+    sqRingSize_(0),
+    sqHead_(NULL),
+    sqTail_(NULL),
+    sqMask_(NULL),
+    sqArray_(NULL),
+    sqes_(NULL),
+    sqesSize_(0),
+    sqLocalTail_(0),
+    cqRing_(NULL),
+    cqRingSize_(0),
+    cqHead_(NULL),
+    cqTail_(NULL),
+    cqMask_(NULL),
+    cqes_(NULL),
+    readBuffers_(new char[kReadBuffers * kReadBufferSize])
+{
+  setupRing();
+  provideBuffers(0, kReadBuffers);  // 随第一次poll提交
+}
+
+IoUringPoller::~IoUringPoller()
+{
+  ::close(ringFd_);  // 先关闭ring, 未完成的读不会再写入readBuffers_
+  ::munmap(sqes_, sqesSize_);
+  if (cqRing_ != sqRing_)
+  {
+    ::munmap(cqRing_, cqRingSize_);
+  }
+  ::munmap(sqRing_, sqRingSize_);
+  delete[] readBuffers_;
+}
+
+void IoUringPoller::setupRing()
+{
+  struct io_uring_params params;
+  memZero(&params, sizeof params);
+  ringFd_ = ioUringSetup(kRingEntries, &params);
+  if (ringFd_ < 0)
+  {
+    LOG_SYSFATAL << "IoUringPoller::setupRing io_uring_setup";
+  }
+
+  // 映射SQ/CQ环, 新内核上两者在同一块内存(IORING_FEAT_SINGLE_MMAP)
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMmap)
+  {
+    sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    cqRingSize_ = sqRingSize_;
+  }
+  sqRing_ = ::mmap(NULL, sqRingSize_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+  if (mmapFailed(sqRing_))
+  {
+    LOG_SYSFATAL << "IoUringPoller::setupRing mmap sq ring";
+  }
+  if (singleMmap)
+  {
+    cqRing_ = sqRing_;
+  }
+  else
+  {
+    cqRing_ = ::mmap(NULL, cqRingSize_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+    if (mmapFailed(cqRing_))
+    {
+      LOG_SYSFATAL << "IoUringPoller::setupRing mmap cq ring";
+    }
+  }
+  sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = ::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+  if (mmapFailed(sqes))
+  {
+    LOG_SYSFATAL << "IoUringPoller::setupRing mmap sqes";
+  }
+  sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+  sqHead_ = ringPtr<unsigned>(sqRing_, params.sq_off.head);
+  sqTail_ = ringPtr<unsigned>(sqRing_, params.sq_off.tail);
+  sqMask_ = ringPtr<unsigned>(sqRing_, params.sq_off.ring_mask);
+  sqArray_ = ringPtr<unsigned>(sqRing_, params.sq_off.array);
+  sqLocalTail_ = *sqTail_;
+
+  cqHead_ = ringPtr<unsigned>(cqRing_, params.cq_off.head);
+  cqTail_ = ringPtr<unsigned>(cqRing_, params.cq_off.tail);
+  cqMask_ = ringPtr<unsigned>(cqRing_, params.cq_off.ring_mask);
+  cqes_ = ringPtr<struct io_uring_cqe>(cqRing_, params.cq_off.cqes);
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels)
+{
+  LOG_TRACE << "fd total count " << channels_.size();
+  provideReturnedBuffers();  // 上一轮的数据已经处理完了
+  armPendingChannels();  // 上一轮触发过的和新注册的fd, 与等待一起提交
+  int ret = submitAndWait(timeoutMs);
+  int savedErrno = errno;
+  Timestamp now(Timestamp::now());
+  if (ret < 0 && savedErrno != EINTR && savedErrno != ETIME)
+  {
+    errno = savedErrno;
+    LOG_SYSERR << "IoUringPoller::poll()";
+  }
+  size_t before = activeChannels->size();
+  fillActiveChannels(activeChannels);
+  if (activeChannels->size() > before)
+  {
+    LOG_TRACE << activeChannels->size() - before << " events happened";
+  }
+  else
+  {
+    LOG_TRACE << "nothing happened";
+  }
+  return now;
+}
+
+int IoUringPoller::submitAndWait(int timeoutMs)
+{
+  __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);  // 发布本轮填好的SQE
+  unsigned toSubmit = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+  if (timeoutMs == 0)
+  {
+    if (toSubmit == 0)
+    {
+      return 0;  // 只收割完成队列, 不需要系统调用
+    }
+    return ioUringEnter(ringFd_, toSubmit, 0, 0, NULL, 0);
+  }
+#ifdef IORING_FEAT_EXT_ARG
+  struct __kernel_timespec ts;
+  struct io_uring_getevents_arg arg;
+  memZero(&arg, sizeof arg);
+  if (timeoutMs > 0)
+  {
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+  }
+  return ioUringEnter(ringFd_, toSubmit, 1,
+                      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                      &arg, sizeof arg);
+#else
+  return ioUringEnter(ringFd_, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+#endif
+}
+
+struct io_uring_sqe* IoUringPoller::getSqe()
+{
+  unsigned entries = *sqMask_ + 1;
+  if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= entries)
+  {
+    // 提交队列满了, 先提交一批, 不等待
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+    if (ioUringEnter(ringFd_, entries, 0, 0, NULL, 0) < 0)
+    {
+      LOG_SYSFATAL << "IoUringPoller::getSqe io_uring_enter";
+    }
+  }
+  unsigned index = sqLocalTail_ & *sqMask_;
+  struct io_uring_sqe* sqe = &sqes_[index];
+  memZero(sqe, sizeof *sqe);
+  sqArray_[index] = index;
+  ++sqLocalTail_;
+  return sqe;
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList* activeChannels)
+{
+  unsigned head = *cqHead_;
+  unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+  for (; head != tail; ++head)
+  {
+    const struct io_uring_cqe* cqe = &cqes_[head & *cqMask_];
+    if (cqe->flags & IORING_CQE_F_BUFFER)
+    {
+      // 不管数据是否还有人要, 这块缓冲区都要在下一轮还给内核
+      returnedBuffers_.push_back(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    }
+    if (cqe->user_data == kCancelTag)
+    {
+      if (cqe->res < 0 && cqe->res != -ENOENT && cqe->res != -EALREADY)
+      {
+        errno = -cqe->res;
+        LOG_SYSERR << "IoUringPoller cancel/provide";  // 要取消的请求已经完成时是ENOENT/EALREADY
+      }
+      continue;
+    }
+    int fd = static_cast<int>(cqe->user_data >> 32);
+    uint32_t op = static_cast<uint32_t>(cqe->user_data >> 30) & 3;
+    uint32_t generation = static_cast<uint32_t>(cqe->user_data) & kGenerationMask;
+    if (implicit_cast<size_t>(fd) >= states_.size())
+    {
+      continue;
+    }
+    PollState& state = states_[fd];
+    int revents = 0;
+    if (op == kOpRead)
+    {
+      // 有读/写未完成的channel不能被删除(见removeChannel), 所以这里的channel一定是提交时的那个
+      assert(state.readPending && state.channel != NULL);
+      state.readPending = false;
+      const char* data = NULL;
+      if (cqe->res > 0)
+      {
+        data = readBuffers_ + static_cast<size_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT) * kReadBufferSize;
+      }
+      state.channel->setAsyncReadResult(data, cqe->res);
+      revents = POLLIN;
+    }
+    else if (op == kOpWrite)
+    {
+      assert(state.writePending && state.channel != NULL);
+      state.writePending = false;
+      state.channel->setAsyncWriteResult(cqe->res);
+      revents = POLLOUT;
+    }
+    else
+    {
+      if (state.channel == NULL || (state.generation & kGenerationMask) != generation)
+      {
+        continue;  // 已被取消或重新注册, 过期的完成事件
+      }
+      state.armed = false;  // oneshot, 需要重新注册
+      revents = cqe->res;
+      if (revents < 0)
+      {
+        errno = -revents;
+        LOG_SYSERR << "IoUringPoller poll fd = " << fd;
+        revents = POLLERR;
+      }
+      queueArm(fd);
+    }
+    state.revents |= revents;
+    if (!state.active)  // 同一个fd本轮可能有poll, 读, 写三个完成, 合并成一次事件
+    {
+      state.active = true;
+      activeFds_.push_back(fd);
+    }
+  }
+  __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+  for (int fd : activeFds_)
+  {
+    PollState& state = states_[fd];
+    Channel* channel = state.channel;
+    channel->set_revents(state.revents);
+    activeChannels->push_back(channel);
+    state.active = false;
+    state.revents = 0;
+  }
+  activeFds_.clear();
+}
+
+void IoUringPoller::armPendingChannels()
+{
+  for (int fd : pendingArms_)
+  {
+    PollState& state = states_[fd];
+    state.queued = false;
+    if (state.channel == NULL || state.armed)
+    {
+      continue;
+    }
+    int events = pollEventsOf(state.channel);
+    if (events == 0)
+    {
+      continue;
+    }
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(events);
+    sqe->user_data = makeUserData(fd, kOpPoll, state.generation);
+    state.armed = true;
+    state.armedEvents = events;
+  }
+  pendingArms_.clear();
+}
+
+void IoUringPoller::queueArm(int fd)
+{
+  PollState& state = states_[fd];
+  if (!state.queued)
+  {
+    state.queued = true;
+    pendingArms_.push_back(fd);
+  }
+}
+
+void IoUringPoller::cancelPoll(int fd, PollState* state)
+{
+  assert(state->armed);
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = makeUserData(fd, kOpPoll, state->generation);
+  sqe->user_data = kCancelTag;
+  state->armed = false;
+  ++state->generation;  // 被取消的请求若已完成, 其完成事件按过期丢弃
+}
+
+void IoUringPoller::cancelOp(uint64_t userData)
+{
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = -1;
+  sqe->addr = userData;
+  sqe->user_data = kCancelTag;
+}
+
+void IoUringPoller::provideBuffers(unsigned first, unsigned count)
+{
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+  sqe->fd = static_cast<int>(count);
+  sqe->addr = reinterpret_cast<uint64_t>(readBuffers_ + static_cast<size_t>(first) * kReadBufferSize);
+  sqe->len = kReadBufferSize;
+  sqe->off = first;  // 起始buffer id, 之后依次加一
+  sqe->buf_group = kBufferGroup;
+  sqe->user_data = kCancelTag;
+}
+
+void IoUringPoller::provideReturnedBuffers()
+{
+  if (returnedBuffers_.empty())
+  {
+    return;
+  }
+  // 相邻的buffer id合并成一个PROVIDE_BUFFERS
+  std::sort(returnedBuffers_.begin(), returnedBuffers_.end());
+  unsigned first = returnedBuffers_[0];
+  unsigned count = 1;
+  for (size_t i = 1; i < returnedBuffers_.size(); ++i)
+  {
+    if (returnedBuffers_[i] == first + count)
+    {
+      ++count;
+    }
+    else
+    {
+      provideBuffers(first, count);
+      first = returnedBuffers_[i];
+      count = 1;
+    }
+  }
+  provideBuffers(first, count);
+  returnedBuffers_.clear();
+}
+
+void IoUringPoller::asyncRead(Channel* channel)
+{
+  Poller::assertInLoopThread();
+  assert(channel->asyncIo() && channel->index() == kAdded);
+  int fd = channel->fd();
+  PollState& state = states_[fd];
+  assert(!state.readPending);
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->flags = IOSQE_BUFFER_SELECT;  // 完成时才从缓冲区组中取一块, 等待中的连接不占内存
+  sqe->buf_group = kBufferGroup;
+  sqe->len = kReadBufferSize;
+  sqe->user_data = makeUserData(fd, kOpRead, 0);
+  state.readPending = true;
+}
+
+void IoUringPoller::asyncWrite(Channel* channel, const struct iovec* iov, int iovcnt)
+{
+  Poller::assertInLoopThread();
+  assert(channel->asyncIo() && channel->index() == kAdded);
+  int fd = channel->fd();
+  PollState& state = states_[fd];
+  assert(!state.writePending);
+  struct io_uring_sqe* sqe = getSqe();
+  sqe->opcode = IORING_OP_WRITEV;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(iov);
+  sqe->len = static_cast<uint32_t>(iovcnt);
+  sqe->user_data = makeUserData(fd, kOpWrite, 0);
+  state.writePending = true;
+}
+
+void IoUringPoller::cancelAsyncIo(Channel* channel, bool read, bool write)
+{
+  Poller::assertInLoopThread();
+  int fd = channel->fd();
+  const PollState& state = states_[fd];
+  if (read && state.readPending)
+  {
+    cancelOp(makeUserData(fd, kOpRead, 0));
+  }
+  if (write && state.writePending)
+  {
+    cancelOp(makeUserData(fd, kOpWrite, 0));
+  }
+}
+
+void IoUringPoller::updateChannel(Channel* channel)
+{
+  Poller::assertInLoopThread();
+  const int index = channel->index();
+  const int fd = channel->fd();
+  LOG_TRACE << "fd = " << fd
+    << " events = " << channel->events() << " index = " << index;
+  if (implicit_cast<size_t>(fd) >= states_.size())
+  {
+    PollState empty = { NULL, 0, 0, false, false, false, false, false, 0 };
+    states_.resize(fd + 1, empty);
+  }
+  PollState& state = states_[fd];
+  if (index == kNew)
+  {
+    assert(channels_.find(fd) == NULL);
+    channels_.insert(fd, channel);
+    channel->set_index(kAdded);
+    state.channel = channel;
+    ++state.generation;
+  }
+  else
+  {
+    assert(index == kAdded);
+    assert(channels_.find(fd) == channel);
+    assert(state.channel == channel);
+  }
+
+  const int events = pollEventsOf(channel);
+  if (state.armed && state.armedEvents != events)
+  {
+    cancelPoll(fd, &state);  // 关注的事件变了, 取消旧请求后重新注册
+  }
+  if (!state.armed && events != 0)
+  {
+    queueArm(fd);
+  }
+}
+
+void IoUringPoller::removeChannel(Channel* channel)
+{
+  Poller::assertInLoopThread();
+  int fd = channel->fd();
+  LOG_TRACE << "fd = " << fd;
+  assert(channels_.find(fd) == channel);
+  assert(channel->isNoneEvent());
+  assert(channel->index() == kAdded);
+
+  PollState& state = states_[fd];
+  assert(!state.readPending && !state.writePending);  // 缓冲区和iovec在完成前还被内核引用
+  if (state.armed)
+  {
+    cancelPoll(fd, &state);
+  }
+  state.channel = NULL;
+  ++state.generation;
+  size_t n = channels_.erase(fd);
+  (void)n;
+  assert(n == 1);
+  channel->set_index(kNew);
+}
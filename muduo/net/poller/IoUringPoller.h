@@ -0,0 +1,108 @@
+#ifndef MUDUO_NET_POLLER_IOURINGPOLLER_H_
+#define MUDUO_NET_POLLER_IOURINGPOLLER_H_
+
+#include "muduo/net/Poller.h"
+
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace muduo
+{
+namespace net
+{
+
+///
+/// IO Multiplexing and asynchronous socket I/O with io_uring(7).
+///
+/// 普通的Channel(监听socket, eventfd, timerfd)用IORING_OP_POLL_ADD: Channel::update()不直接调用epoll_ctl,
+/// 而是把POLL_ADD/POLL_REMOVE放入提交队列(SQ), 在下一次poll()时和等待一起用一个io_uring_enter批量提交。
+/// 使用单次(oneshot)poll, 事件触发后在下一轮poll时重新注册, 保持与EPollPoller一致的水平触发语义。
+///
+/// 异步读写的Channel(TcpConnection, 见Channel::setAsyncIo())不等待可读: 读是IORING_OP_RECV,
+/// 由内核从本poller提供的缓冲区组(IORING_OP_PROVIDE_BUFFERS)中选一块, 空闲连接不占缓冲区;
+/// 写是IORING_OP_WRITEV, 直接从连接的outputBuffer_写出。提交和收割都并入每轮一次的io_uring_enter,
+/// 忙碌的loop上每个请求不再需要单独的read/write系统调用。
+///
+/// 需要内核支持IORING_FEAT_EXT_ARG(5.11+), 否则DefaultPoller回退到EPollPoller。
+///
+class IoUringPoller : public Poller
+{
+ public:
+  IoUringPoller(EventLoop* loop);
+  ~IoUringPoller() override;
+
+  Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+  void updateChannel(Channel* channel) override;
+  void removeChannel(Channel* channel) override;
+  bool supportsAsyncIo() const override { return true; }
+  void asyncRead(Channel* channel) override;
+  void asyncWrite(Channel* channel, const struct iovec* iov, int iovcnt) override;
+  void cancelAsyncIo(Channel* channel, bool read, bool write) override;
+
+  /// 当前内核是否可以使用本poller
+  static bool available();
+
+ private:
+  static const unsigned kRingEntries = 1024;
+  static const unsigned kReadBufferSize = 8 * 1024;  // 异步读每次最多读这么多
+  static const unsigned kReadBuffers = 256;  // 缓冲区组的大小, 一轮中超过这么多个读完成时, 后面的读得到ENOBUFS
+
+  /// 每个fd的注册状态, 以fd为下标
+  struct PollState
+  {
+    Channel* channel;
+    uint32_t generation;  // 每次重新注册/删除都加一, 用于丢弃过期的完成事件
+    int armedEvents;  // 已提交给内核的事件
+    bool armed;  // 内核中是否有该fd的poll请求
+    bool queued;  // 是否已在pendingArms_中
+    bool readPending;  // 有未完成的异步读
+    bool writePending;  // 有未完成的异步写
+    bool active;  // 本轮收割中已经放进activeFds_
+    int revents;  // 本轮收割累计的事件
+  };
+
+  void setupRing();
+  io_uring_sqe* getSqe();
+  int submitAndWait(int timeoutMs);
+  void armPendingChannels();
+  void queueArm(int fd);
+  void cancelPoll(int fd, PollState* state);
+  void cancelOp(uint64_t userData);
+  void provideBuffers(unsigned first, unsigned count);
+  void provideReturnedBuffers();
+  void fillActiveChannels(ChannelList* activeChannels);
+
+  int ringFd_;
+
+  // 提交队列(SQ), 与内核共享内存
+  void* sqRing_;
+  size_t sqRingSize_;
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned* sqMask_;
+  unsigned* sqArray_;
+  io_uring_sqe* sqes_;
+  size_t sqesSize_;
+  unsigned sqLocalTail_;  // 已填好但还没有发布给内核的尾部
+
+  // 完成队列(CQ)
+  void* cqRing_;
+  size_t cqRingSize_;
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  unsigned* cqMask_;
+  io_uring_cqe* cqes_;
+
+  std::vector<PollState> states_;
+  std::vector<int> pendingArms_;  // 本轮需要(重新)注册poll的fd
+  std::vector<int> activeFds_;  // 收割时用, 同一个fd的多个完成合并成一次事件
+
+  char* readBuffers_;  // kReadBuffers块kReadBufferSize字节, 第i块的buffer id是i
+  std::vector<unsigned> returnedBuffers_;  // 上一轮读完成用掉的块, 它们的数据已经交给了channel, 下一轮还给内核
+};
+
+}  // namespace net
+}  // namespace muduo
+#endif  // MUDUO_NET_POLLER_IOURINGPOLLER_H_
@@ -61,9 +61,8 @@ void PollPoller::fillActiveChannels(int numEvents,
     if (pfd->revents > 0)
     {
       --numEvents;
-      ChannelMap::const_iterator ch = channels_.find(pfd->fd);
-      assert(ch != channels_.end());
-      Channel* channel = ch->second;
+      Channel* channel = channels_.find(pfd->fd);
+      assert(channel != NULL);
       assert(channel->fd() == pfd->fd);
       channel->set_revents(pfd->revents);
       // pfd->revents = 0;
@@ -79,7 +78,7 @@ void PollPoller::updateChannel(Channel* channel)
   if (channel->index() < 0)
   {
     // a new one, add to pollfds_
-    assert(channels_.find(channel->fd()) == channels_.end());
+    assert(channels_.find(channel->fd()) == NULL);
     struct pollfd pfd;
     // 将channel的内容转移到pfd中
     pfd.fd = channel->fd();
@@ -89,13 +88,12 @@ void PollPoller::updateChannel(Channel* channel)
     int idx = static_cast<int>(pollfds_.size())-1;
     channel->set_index(idx);
     // 可以根据fd得到channel
-    channels_[pfd.fd] = channel;
+    channels_.insert(pfd.fd, channel);
   }
   else
   {
     // update existing one
-    assert(channels_.find(channel->fd()) != channels_.end());
-    assert(channels_[channel->fd()] == channel);
+    assert(channels_.find(channel->fd()) == channel);
     int idx = channel->index();
     assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
     struct pollfd& pfd = pollfds_[idx];
@@ -115,8 +113,7 @@ void PollPoller::removeChannel(Channel* channel)
 {
   Poller::assertInLoopThread();
   LOG_TRACE << "fd = " << channel->fd();
-  assert(channels_.find(channel->fd()) != channels_.end());
-  assert(channels_[channel->fd()] == channel);
+  assert(channels_.find(channel->fd()) == channel);
   assert(channel->isNoneEvent());
   int idx = channel->index();
   assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
@@ -136,7 +133,7 @@ void PollPoller::removeChannel(Channel* channel)
     {
       channelAtEnd = -channelAtEnd-1;
     }
-    channels_[channelAtEnd]->set_index(idx);
+    channels_.find(channelAtEnd)->set_index(idx);
     pollfds_.pop_back();
   }
 }
@@ -0,0 +1,143 @@
+// 空闲连接占用的缓冲区内存: 每个连接收一个较大的请求, 之后保持空闲
+// 分别在关闭/打开BufferPool回收的情况下, 统计处理完后各连接输入缓冲区占用的容量和进程RSS。
+// 请求分批到达(每批batch个连接), 同一时刻只有一批连接是活跃的。
+// 每种模式在单独的子进程中运行, RSS互不影响。
+//
+// usage: bufferpool_bench [connections] [requestKB] [batch]
+
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/BufferPool.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+long residentKB()
+{
+  long pages = 0;
+  long resident = 0;
+  FILE* fp = ::fopen("/proc/self/statm", "r");
+  if (fp)
+  {
+    if (::fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+    {
+      resident = 0;
+    }
+    ::fclose(fp);
+  }
+  return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void run(bool recycle, int connections, size_t requestBytes, int batch)
+{
+  EventLoop loop;
+  loop.bufferPool()->setRecycle(recycle);
+  long rssStart = residentKB();
+
+  std::vector<TcpConnectionPtr> conns;
+  std::vector<int> peers;
+  const std::vector<char> request(requestBytes, 'r');
+  size_t received = 0;
+  size_t expected = 0;
+  int next = 0;
+
+  std::function<void()> sendBatch = [&] {
+    int end = std::min(next + batch, connections);
+    for (; next < end; ++next)
+    {
+      if (::write(peers[next], request.data(), request.size()) != static_cast<ssize_t>(request.size()))
+      {
+        perror("write");
+        exit(1);
+      }
+      expected += request.size();
+    }
+  };
+
+  for (int i = 0; i < connections; ++i)
+  {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+      perror("socketpair");
+      exit(1);
+    }
+    char name[32];
+    snprintf(name, sizeof name, "conn#%d", i);
+    TcpConnectionPtr conn(new TcpConnection(&loop, name, fds[0], InetAddress(), InetAddress()));
+    conn->setConnectionCallback([](const TcpConnectionPtr&) {});
+    conn->setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+      received += buf->readableBytes();
+      buf->retrieveAll();
+      if (received == expected)  // 这一批处理完, 下一批到达
+      {
+        if (next < connections)
+        {
+          loop.queueInLoop(sendBatch);
+        }
+        else
+        {
+          loop.quit();
+        }
+      }
+    });
+    conn->connectEstablished();
+    conns.push_back(conn);
+    peers.push_back(fds[1]);
+  }
+
+  Timestamp start(Timestamp::now());
+  sendBatch();
+  loop.loop();
+  double seconds = timeDifference(Timestamp::now(), start);
+
+  size_t held = 0;
+  for (const TcpConnectionPtr& conn : conns)
+  {
+    held += conn->inputBuffer()->internalCapacity();
+  }
+  BufferPool::Stats stats = loop.bufferPool()->stats();
+  printf("recycle %-3s: %.3f s, idle input buffers hold %8.1f KiB (%6.1f B/conn), "
+         "pool free %zu KiB in %zu buffers, RSS +%ld KiB\n",
+         recycle ? "on" : "off", seconds,
+         static_cast<double>(held) / 1024, static_cast<double>(held) / connections,
+         static_cast<size_t>(stats.bufferBytesFree / 1024), static_cast<size_t>(stats.buffersFree),
+         residentKB() - rssStart);
+
+  for (size_t i = 0; i < conns.size(); ++i)
+  {
+    conns[i]->connectDestroyed();
+    ::close(peers[i]);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int connections = argc > 1 ? atoi(argv[1]) : 4000;
+  size_t requestBytes = (argc > 2 ? atoi(argv[2]) : 32) * 1024;
+  int batch = argc > 3 ? atoi(argv[3]) : 64;
+  printf("connections = %d, request = %zu KiB, batch = %d\n", connections, requestBytes / 1024, batch);
+  fflush(stdout);
+
+  for (int recycle = 0; recycle < 2; ++recycle)
+  {
+    pid_t pid = ::fork();
+    if (pid == 0)
+    {
+      run(recycle != 0, connections, requestBytes, batch);
+      fflush(stdout);
+      _exit(0);
+    }
+    ::waitpid(pid, NULL, 0);
+  }
+}
@@ -0,0 +1,146 @@
+// 忙轮询对延迟的影响: ping-pong往返时延
+// 主线程跑echo服务器的loop, 客户端线程用阻塞socket逐个发送msgSize字节的消息并等回显,
+// 先测阻塞等待(默认), 再EventLoop::setBusyPoll(budget)后测一遍, 输出往返时延的分位数和服务器loop线程的CPU占用。
+// 客户端和服务器应该在不同的CPU上(比如taskset -c 0,1), 只有一个CPU时空转会抢走客户端的时间, 结果没有意义。
+//
+// usage: busypoll_bench [roundTrips] [budgetUs] [msgSize]
+
+#include "muduo/base/Thread.h"
+#include "muduo/base/Logging.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpServer.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+int64_t nowNs(clockid_t clock)
+{
+  struct timespec ts;
+  ::clock_gettime(clock, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+bool readFully(int fd, char* buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = sockets::read(fd, buf, len);
+    if (n <= 0)
+    {
+      return false;
+    }
+    buf += n;
+    len -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+void pingPong(const char* name, int fd, int roundTrips, size_t msgSize, clockid_t serverClock)
+{
+  std::vector<char> msg(msgSize, 'p');
+  std::vector<char> reply(msgSize);
+  std::vector<int64_t> rtt;
+  rtt.reserve(roundTrips);
+  const int warmup = std::min(roundTrips / 10, 1000);
+  int64_t wallStart = 0;
+  int64_t cpuStart = 0;
+  for (int i = -warmup; i < roundTrips; ++i)
+  {
+    if (i == 0)
+    {
+      wallStart = nowNs(CLOCK_MONOTONIC);
+      cpuStart = nowNs(serverClock);
+    }
+    int64_t start = nowNs(CLOCK_MONOTONIC);
+    if (sockets::write(fd, msg.data(), msgSize) != static_cast<ssize_t>(msgSize)
+        || !readFully(fd, reply.data(), msgSize))
+    {
+      perror("ping-pong");
+      exit(1);
+    }
+    if (i >= 0)
+    {
+      rtt.push_back(nowNs(CLOCK_MONOTONIC) - start);
+    }
+  }
+  double wall = static_cast<double>(nowNs(CLOCK_MONOTONIC) - wallStart);
+  double cpu = static_cast<double>(nowNs(serverClock) - cpuStart);
+
+  std::sort(rtt.begin(), rtt.end());
+  auto percentile = [&rtt](double p) {
+    return static_cast<double>(rtt[static_cast<size_t>(p * static_cast<double>(rtt.size() - 1))]) / 1000;
+  };
+  printf("%-10s p50 %7.1f us  p99 %7.1f us  p99.9 %7.1f us  max %8.1f us  server loop CPU %5.1f%%\n",
+         name, percentile(0.5), percentile(0.99), percentile(0.999), percentile(1.0),
+         cpu * 100 / wall);
+}
+
+uint16_t freePort()
+{
+  int fd = sockets::createNonblockingOrDie(AF_INET);
+  sockets::bindOrDie(fd, InetAddress(0, true).getSockAddr());
+  uint16_t port = InetAddress(sockets::getLocalAddr(fd)).port();
+  sockets::close(fd);
+  return port;
+}
+
+int main(int argc, char* argv[])
+{
+  int roundTrips = argc > 1 ? atoi(argv[1]) : 50 * 1000;
+  int budgetUs = argc > 2 ? atoi(argv[2]) : 50;
+  size_t msgSize = argc > 3 ? atoi(argv[3]) : 64;
+  printf("round trips = %d, busy poll budget = %d us, message = %zu bytes\n",
+         roundTrips, budgetUs, msgSize);
+  Logger::setLogLevel(Logger::WARN);
+
+  EventLoop loop;
+  InetAddress listenAddr(freePort(), true);
+  TcpServer server(&loop, listenAddr, "busypoll_bench");
+  server.setConnectionCallback([](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      conn->setTcpNoDelay(true);
+    }
+  });
+  server.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    conn->send(buf);
+  });
+  server.start();  // 在loop线程中调用, 返回时已经在listen
+
+  clockid_t serverClock;
+  ::pthread_getcpuclockid(::pthread_self(), &serverClock);
+
+  Thread client([&] {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);  // 阻塞socket
+    if (fd < 0 || ::connect(fd, listenAddr.getSockAddr(), static_cast<socklen_t>(sizeof(struct sockaddr_in))) < 0)
+    {
+      perror("connect");
+      exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, static_cast<socklen_t>(sizeof one));
+
+    pingPong("blocking", fd, roundTrips, msgSize, serverClock);
+    loop.setBusyPoll(budgetUs);  // 任意线程可调用, 下一轮poll生效
+    pingPong("busy-poll", fd, roundTrips, msgSize, serverClock);
+
+    sockets::close(fd);
+    loop.quit();
+  }, "client");
+  client.start();
+  loop.loop();
+  client.join();
+}
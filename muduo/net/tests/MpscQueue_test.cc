@@ -0,0 +1,228 @@
+// MpscQueue多生产者压力测试: 多个线程同时push, 消费者交替用drain和pop取,
+// 检查每个元素恰好取到一次、同一生产者的元素保持先后顺序,
+// 以及不会有元素滞留在哨兵之前(生产者全部结束后一次drain就能取空, 等待被取走的生产者不会超时),
+// 节点池中的节点被反复使用。
+
+#include "muduo/base/MpscQueue.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <sched.h>
+
+#define BOOST_TEST_MAIN
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+using muduo::MpscQueue;
+using muduo::Thread;
+
+namespace
+{
+
+const int kProducers = 8;
+const int kItemsPerProducer = 50000;
+
+/// 高32位是生产者编号, 低32位是序号
+long encode(int producer, int seq)
+{
+  return (static_cast<long>(producer) << 32) | seq;
+}
+
+struct Checker
+{
+  Checker()
+    : received(0),
+      nextSeq(kProducers, 0),
+      ok(true)
+  {
+  }
+
+  void operator()(long item)
+  {
+    int producer = static_cast<int>(item >> 32);
+    int seq = static_cast<int>(item & 0xffffffff);
+    if (producer < 0 || producer >= kProducers || seq != nextSeq[producer])
+    {
+      ok = false;
+    }
+    else
+    {
+      ++nextSeq[producer];
+    }
+    ++received;
+  }
+
+  long received;
+  std::vector<int> nextSeq;
+  bool ok;
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(testMultiProducerDrain)
+{
+  MpscQueue<long> queue;
+  std::atomic<int> finished(0);
+  std::vector<std::unique_ptr<Thread>> producers;
+  for (int i = 0; i < kProducers; ++i)
+  {
+    producers.emplace_back(new Thread([&queue, &finished, i] {
+      for (int seq = 0; seq < kItemsPerProducer; ++seq)
+      {
+        queue.push(encode(i, seq));
+      }
+      finished.fetch_add(1);
+    }));
+    producers.back()->start();
+  }
+
+  Checker checker;
+  long item = 0;
+  int round = 0;
+  while (finished.load() < kProducers)
+  {
+    // 交替使用两种取法, pop在只剩一个节点时会把哨兵放回队尾, 和生产者竞争tail_
+    if (++round % 2 == 0)
+    {
+      queue.drain([&checker](long x) { checker(x); });
+    }
+    else if (queue.pop(&item))
+    {
+      checker(item);
+    }
+  }
+  for (auto& thr : producers)
+  {
+    thr->join();
+  }
+
+  // 生产者都已结束, 剩下的都已链接好, 一次drain必须全部取出
+  const long total = static_cast<long>(kProducers) * kItemsPerProducer;
+  long remaining = total - checker.received;
+  BOOST_CHECK_EQUAL(static_cast<long>(queue.drain([&checker](long x) { checker(x); })), remaining);
+  BOOST_CHECK_EQUAL(checker.received, total);
+  BOOST_CHECK(checker.ok);
+  BOOST_CHECK(!queue.pop(&item));
+  BOOST_CHECK_EQUAL(queue.drain([&checker](long x) { checker(x); }), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testNoItemLeftBehindStub)
+{
+  // 每个生产者同时只有一个元素在队列中, 等它被取走再push下一个。
+  // 队列经常只剩一个节点, 取走它时放回哨兵容易与其他生产者的push交错
+  const int kItems = 20000;
+  MpscQueue<long> queue;
+  std::vector<std::atomic<int>> consumed(kProducers);
+  for (std::atomic<int>& c : consumed)
+  {
+    c.store(0);
+  }
+  std::atomic<int> finished(0);
+  std::atomic<bool> timeout(false);
+  std::atomic<long> pushed(0);
+  std::vector<std::unique_ptr<Thread>> producers;
+  for (int i = 0; i < kProducers; ++i)
+  {
+    producers.emplace_back(new Thread([&, i] {
+      for (int seq = 0; seq < kItems && !timeout.load(); ++seq)
+      {
+        queue.push(encode(i, seq));
+        pushed.fetch_add(1);
+        muduo::Timestamp deadline = muduo::addTime(muduo::Timestamp::now(), 5.0);
+        while (consumed[i].load() <= seq)
+        {
+          if (muduo::Timestamp::now() > deadline)
+          {
+            timeout.store(true);
+            break;
+          }
+          ::sched_yield();
+        }
+      }
+      finished.fetch_add(1);
+    }));
+    producers.back()->start();
+  }
+
+  Checker checker;
+  auto consume = [&checker, &consumed](long x) {
+    checker(x);
+    consumed[x >> 32].fetch_add(1);
+  };
+  // 和EventLoop一样只用drain, drain取最后一个节点时也要放回哨兵。
+  // drain开始前已经push完的元素必须在这次drain中取到, EventLoop依赖这一点才不会丢任务
+  long missed = 0;
+  while (finished.load() < kProducers)
+  {
+    long pushedBefore = pushed.load();
+    if (queue.drain(consume) == 0)
+    {
+      ::sched_yield();
+    }
+    if (checker.received < pushedBefore)
+    {
+      ++missed;
+    }
+  }
+  for (auto& thr : producers)
+  {
+    thr->join();
+  }
+  BOOST_CHECK_EQUAL(missed, 0);
+  BOOST_CHECK(!timeout.load());
+  BOOST_CHECK_EQUAL(checker.received, static_cast<long>(kProducers) * kItems);
+  BOOST_CHECK(checker.ok);
+}
+
+BOOST_AUTO_TEST_CASE(testDrainAfterPopEmptiesQueue)
+{
+  // 单线程下pop把哨兵放回队尾后, drain仍能取到之后push的元素
+  MpscQueue<long> queue;
+  long item = 0;
+  for (int i = 0; i < 100; ++i)
+  {
+    queue.push(i);
+    BOOST_CHECK(queue.pop(&item));
+    BOOST_CHECK_EQUAL(item, i);
+    queue.push(i);
+    queue.push(i + 1);
+    long sum = 0;
+    BOOST_CHECK_EQUAL(queue.drain([&sum](long x) { sum += x; }), 2u);
+    BOOST_CHECK_EQUAL(sum, 2 * i + 1);
+    BOOST_CHECK(queue.empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(testNodesRecycled)
+{
+  // 节点取走后回到节点池, 反复push/drain不再扩充
+  MpscQueue<long> queue;
+  for (int round = 0; round < 100; ++round)
+  {
+    for (int i = 0; i < 1000; ++i)
+    {
+      queue.push(i);
+    }
+    BOOST_CHECK_EQUAL(queue.drain([](long) {}), 1000u);
+  }
+  BOOST_CHECK_EQUAL(queue.pooledNodes(), 1024u);
+
+  // 超出节点池上限的节点直接new, 取走时delete
+  const long kMany = 70000;
+  for (long i = 0; i < kMany; ++i)
+  {
+    queue.push(i);
+  }
+  long sum = 0;
+  BOOST_CHECK_EQUAL(static_cast<long>(queue.drain([&sum](long x) { sum += x; })), kMany);
+  BOOST_CHECK_EQUAL(sum, kMany * (kMany - 1) / 2);
+  BOOST_CHECK_EQUAL(queue.pooledNodes(), 65536u);
+  queue.push(1);
+  long item = 0;
+  BOOST_CHECK(queue.pop(&item));
+  BOOST_CHECK_EQUAL(queue.pooledNodes(), 65536u);
+}
@@ -0,0 +1,163 @@
+// Poller中fd->Channel查找表的开销: 模拟连接的建立和关闭
+// 1. 数据结构本身: 原先的 std::map<int, Channel*> 与 fd下标的数组对比
+// 2. 端到端: 每个连接一个(未连接的)TCP socket, Channel注册/开关可写/注销, 分别用epoll和poll
+// 同时保持live个连接, 总共churn个连接; fd按内核的规则复用最小的空闲号
+//
+// usage: poller_bench [churn] [live]
+
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/Channel.h"
+#include "muduo/net/EventLoop.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 原先Poller::channels_的做法
+class MapTable
+{
+ public:
+  Channel* find(int fd) const
+  {
+    std::map<int, Channel*>::const_iterator it = channels_.find(fd);
+    return it == channels_.end() ? NULL : it->second;
+  }
+  void insert(int fd, Channel* channel) { channels_[fd] = channel; }
+  void erase(int fd) { channels_.erase(fd); }
+
+ private:
+  std::map<int, Channel*> channels_;
+};
+
+// 现在Poller::ChannelTable的做法
+class VectorTable
+{
+ public:
+  Channel* find(int fd) const
+  { return static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : NULL; }
+  void insert(int fd, Channel* channel)
+  {
+    if (static_cast<size_t>(fd) >= channels_.size())
+    {
+      channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2));
+    }
+    channels_[fd] = channel;
+  }
+  void erase(int fd) { channels_[fd] = NULL; }
+
+ private:
+  std::vector<Channel*> channels_;
+};
+
+// 每个连接: 登记, 三次查找(对应updateChannel/hasChannel的断言), 注销
+template<typename Table>
+void benchTable(const char* name, int churn, int live)
+{
+  Table table;
+  std::deque<int> fds;
+  std::vector<int> freeFds;  // 模拟内核分配最小的空闲fd
+  int nextFd = 3;
+  Channel* dummy = reinterpret_cast<Channel*>(&table);
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < churn; ++i)
+  {
+    int fd = 0;
+    if (freeFds.empty())
+    {
+      fd = nextFd++;
+    }
+    else
+    {
+      std::vector<int>::iterator it = std::min_element(freeFds.begin(), freeFds.end());
+      fd = *it;
+      *it = freeFds.back();
+      freeFds.pop_back();
+    }
+    table.insert(fd, dummy);
+    for (int k = 0; k < 3; ++k)
+    {
+      if (table.find(fd) != dummy)
+      {
+        abort();
+      }
+    }
+    fds.push_back(fd);
+    if (static_cast<int>(fds.size()) > live)
+    {
+      table.erase(fds.front());
+      freeFds.push_back(fds.front());
+      fds.pop_front();
+    }
+  }
+  printf("%-12s %6.1f ns/connection\n", name,
+         timeDifference(Timestamp::now(), start) * 1e9 / churn);
+}
+
+void benchLoop(const char* name, int churn, int live)
+{
+  EventLoop loop;
+  struct Conn
+  {
+    int fd;
+    std::unique_ptr<Channel> channel;
+  };
+  std::deque<Conn> conns;
+  Timestamp start(Timestamp::now());
+  for (int i = 0; i < churn; ++i)
+  {
+    Conn conn;
+    conn.fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (conn.fd < 0)
+    {
+      perror("socket");
+      exit(1);
+    }
+    conn.channel.reset(new Channel(&loop, conn.fd));
+    conn.channel->enableReading();   // ADD
+    conn.channel->enableWriting();   // MOD
+    conn.channel->disableWriting();  // MOD
+    conns.push_back(std::move(conn));
+    if (static_cast<int>(conns.size()) > live)
+    {
+      Conn& old = conns.front();
+      old.channel->disableAll();  // DEL
+      old.channel->remove();
+      ::close(old.fd);
+      conns.pop_front();
+    }
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (Conn& conn : conns)
+  {
+    conn.channel->disableAll();
+    conn.channel->remove();
+    ::close(conn.fd);
+  }
+  printf("%-12s %6.1f us/connection (socket + register/modify/remove + close)\n",
+         name, seconds * 1e6 / churn);
+}
+
+int main(int argc, char* argv[])
+{
+  int churn = argc > 1 ? atoi(argv[1]) : 100 * 1000;
+  int live = argc > 2 ? atoi(argv[2]) : 10 * 1000;
+  printf("churn = %d, live = %d\n", churn, live);
+
+  benchTable<MapTable>("std::map", churn, live);
+  benchTable<VectorTable>("fd table", churn, live);
+
+  ::unsetenv("MUDUO_USE_POLL");
+  benchLoop("EPollPoller", churn, live);
+  ::setenv("MUDUO_USE_POLL", "1", 1);
+  benchLoop("PollPoller", churn, live);
+}
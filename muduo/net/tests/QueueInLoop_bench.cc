@@ -0,0 +1,167 @@
+// 跨线程投递任务的吞吐测试
+// 1. 队列本身: 原先的 mutex + vector swap 与 MpscQueue 对比
+// 2. 端到端: 多个生产者线程向同一个EventLoop queueInLoop
+//
+// usage: queueinloop_bench [producers] [postsPerProducer]
+
+#include "muduo/base/MpscQueue.h"
+#include "muduo/base/Mutex.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+typedef std::function<void()> Functor;
+
+// 原先EventLoop的实现: 生产者加锁push_back, 消费者加锁swap
+class MutexFunctorQueue : noncopyable
+{
+ public:
+  void push(Functor f)
+  {
+    MutexLockGuard lock(mutex_);
+    functors_.push_back(std::move(f));
+  }
+
+  size_t drain()
+  {
+    std::vector<Functor> functors;
+    {
+    MutexLockGuard lock(mutex_);
+    functors.swap(functors_);
+    }
+    for (const Functor& f : functors)
+    {
+      f();
+    }
+    return functors.size();
+  }
+
+ private:
+  MutexLock mutex_;
+  std::vector<Functor> functors_ GUARDED_BY(mutex_);
+};
+
+class LockFreeFunctorQueue : noncopyable
+{
+ public:
+  void push(Functor f)
+  {
+    queue_.push(std::move(f));
+  }
+
+  size_t drain()
+  {
+    return queue_.drain([](const Functor& f) { f(); });
+  }
+
+ private:
+  MpscQueue<Functor> queue_;
+};
+
+template<typename Queue>
+double benchQueue(int producers, int posts)
+{
+  Queue queue;
+  int64_t counter = 0;  // 只在消费者线程修改
+  const int64_t total = static_cast<int64_t>(producers) * posts;
+  std::atomic<bool> go(false);
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < producers; ++i)
+  {
+    threads.emplace_back(new Thread([&queue, &counter, &go, posts] {
+      while (!go.load())
+      {
+      }
+      for (int j = 0; j < posts; ++j)
+      {
+        queue.push([&counter] { ++counter; });
+      }
+    }));
+    threads.back()->start();
+  }
+
+  Timestamp start(Timestamp::now());
+  go.store(true);
+  int64_t done = 0;
+  while (done < total)
+  {
+    done += static_cast<int64_t>(queue.drain());
+  }
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (auto& t : threads)
+  {
+    t->join();
+  }
+  if (counter != total)
+  {
+    printf("ERROR: counter %ld != %ld\n", counter, total);
+  }
+  return static_cast<double>(total) / seconds;
+}
+
+double benchEventLoop(int producers, int posts)
+{
+  EventLoopThread loopThread;
+  EventLoop* loop = loopThread.startLoop();
+  const int64_t total = static_cast<int64_t>(producers) * posts;
+  int64_t counter = 0;  // 只在loop线程修改
+  CountDownLatch finished(1);
+  std::atomic<bool> go(false);
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i < producers; ++i)
+  {
+    threads.emplace_back(new Thread([=, &counter, &finished, &go] {
+      while (!go.load())
+      {
+      }
+      for (int j = 0; j < posts; ++j)
+      {
+        loop->queueInLoop([&counter, &finished, total] {
+          if (++counter == total)
+          {
+            finished.countDown();
+          }
+        });
+      }
+    }));
+    threads.back()->start();
+  }
+
+  Timestamp start(Timestamp::now());
+  go.store(true);
+  finished.wait();
+  double seconds = timeDifference(Timestamp::now(), start);
+  for (auto& t : threads)
+  {
+    t->join();
+  }
+  return static_cast<double>(total) / seconds;
+}
+
+int main(int argc, char* argv[])
+{
+  int producers = argc > 1 ? atoi(argv[1]) : 4;
+  int posts = argc > 2 ? atoi(argv[2]) : 1000 * 1000;
+  printf("producers = %d, posts per producer = %d\n", producers, posts);
+
+  double mutexRate = benchQueue<MutexFunctorQueue>(producers, posts);
+  double mpscRate = benchQueue<LockFreeFunctorQueue>(producers, posts);
+  printf("queue only   mutex+vector: %10.0f posts/s\n", mutexRate);
+  printf("queue only   mpsc        : %10.0f posts/s (%.2fx)\n", mpscRate, mpscRate / mutexRate);
+
+  double loopRate = benchEventLoop(producers, posts);
+  printf("EventLoop::queueInLoop   : %10.0f posts/s\n", loopRate);
+}
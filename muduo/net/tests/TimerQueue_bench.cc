@@ -0,0 +1,224 @@
+// 定时器插入/取消/到期的吞吐测试
+// 1. 数据结构本身: 原先的 std::set + new Timer 与 TimingWheel + 节点池对比
+// 2. 端到端: EventLoop::runAfter/cancel, 以及大量定时器批量到期
+//
+// usage: timerqueue_bench [timers]
+
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/Timer.h"
+#include "muduo/net/TimingWheel.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+// 原先TimerQueue的实现: 按时间排序的set加上按地址排序的set, 每个定时器new一次
+class SetTimerList : noncopyable
+{
+ public:
+  ~SetTimerList()
+  {
+    for (const Entry& entry : timers_)
+    {
+      delete entry.second;
+    }
+  }
+
+  std::pair<Timer*, int64_t> add(Timestamp when)
+  {
+    Timer* timer = new Timer(TimerCallback(), when, 0.0);
+    timers_.insert(Entry(when, timer));
+    activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
+    return ActiveTimer(timer, timer->sequence());
+  }
+
+  void cancel(std::pair<Timer*, int64_t> id)
+  {
+    ActiveTimerSet::iterator it = activeTimers_.find(id);
+    if (it != activeTimers_.end())
+    {
+      timers_.erase(Entry(it->first->expiration(), it->first));
+      delete it->first;
+      activeTimers_.erase(it);
+    }
+  }
+
+ private:
+  typedef std::pair<Timestamp, Timer*> Entry;
+  typedef std::pair<Timer*, int64_t> ActiveTimer;
+  typedef std::set<ActiveTimer> ActiveTimerSet;
+
+  std::set<Entry> timers_;
+  ActiveTimerSet activeTimers_;
+};
+
+// TimerQueue中的做法: 时间轮加上loop线程内的节点池
+class WheelTimerList : noncopyable
+{
+ public:
+  WheelTimerList()
+    : wheel_(TimingWheel::nowTick(Timestamp::now()))
+  {
+  }
+
+  ~WheelTimerList()
+  {
+    std::vector<Timer*> timers;
+    wheel_.takeAll(&timers);
+    for (Timer* timer : timers)
+    {
+      delete timer;
+    }
+    for (Timer* timer : freeTimers_)
+    {
+      delete timer;
+    }
+  }
+
+  std::pair<Timer*, int64_t> add(Timestamp when)
+  {
+    Timer* timer = NULL;
+    if (freeTimers_.empty())
+    {
+      timer = new Timer(TimerCallback(), when, 0.0);
+    }
+    else
+    {
+      timer = freeTimers_.back();
+      freeTimers_.pop_back();
+      timer->reset(TimerCallback(), when, 0.0);
+    }
+    wheel_.add(timer);
+    return std::make_pair(timer, timer->sequence());
+  }
+
+  void cancel(std::pair<Timer*, int64_t> id)
+  {
+    Timer* timer = id.first;
+    if (timer->sequence() == id.second && timer->inWheel())
+    {
+      wheel_.remove(timer);
+      freeTimers_.push_back(timer);
+    }
+  }
+
+ private:
+  TimingWheel wheel_;
+  std::vector<Timer*> freeTimers_;
+};
+
+template<typename List>
+void benchList(const char* name, const std::vector<Timestamp>& whens, int rounds)
+{
+  List list;
+  std::vector<std::pair<Timer*, int64_t>> ids(whens.size());
+  std::vector<size_t> order(whens.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(42));
+
+  double addSeconds = 0;
+  double cancelSeconds = 0;
+  for (int r = 0; r < rounds; ++r)  // 第二轮起节点池已经热身
+  {
+    Timestamp start(Timestamp::now());
+    for (size_t i = 0; i < whens.size(); ++i)
+    {
+      ids[i] = list.add(whens[i]);
+    }
+    Timestamp mid(Timestamp::now());
+    for (size_t i : order)
+    {
+      list.cancel(ids[i]);
+    }
+    Timestamp end(Timestamp::now());
+    addSeconds += timeDifference(mid, start);
+    cancelSeconds += timeDifference(end, mid);
+  }
+  double n = static_cast<double>(whens.size()) * rounds;
+  printf("%-12s add %6.1f ns/timer, cancel %6.1f ns/timer\n",
+         name, addSeconds * 1e9 / n, cancelSeconds * 1e9 / n);
+}
+
+void benchEventLoop(int timers)
+{
+  EventLoop loop;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> delay(0.0, 1.0);
+
+  // runAfter + cancel, 定时器不到期
+  {
+    std::vector<TimerId> ids;
+    ids.reserve(timers);
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < timers; ++i)
+    {
+      ids.push_back(loop.runAfter(60.0 + delay(gen), [] {}));
+    }
+    Timestamp mid(Timestamp::now());
+    for (const TimerId& id : ids)
+    {
+      loop.cancel(id);
+    }
+    Timestamp end(Timestamp::now());
+    printf("EventLoop    runAfter %6.1f ns/timer, cancel %6.1f ns/timer\n",
+           timeDifference(mid, start) * 1e9 / timers,
+           timeDifference(end, mid) * 1e9 / timers);
+  }
+
+  // 全部在1秒内到期, 统计触发延迟
+  {
+    int fired = 0;
+    double totalLate = 0;
+    double maxLate = 0;
+    Timestamp start(Timestamp::now());
+    for (int i = 0; i < timers; ++i)
+    {
+      Timestamp when = addTime(start, delay(gen));
+      loop.runAt(when, [&, when] {
+        double late = timeDifference(Timestamp::now(), when);
+        totalLate += late;
+        maxLate = std::max(maxLate, late);
+        if (++fired == timers)
+        {
+          loop.quit();
+        }
+      });
+    }
+    loop.loop();
+    printf("EventLoop    %d timers fired in %.3f s, lateness avg %.3f ms max %.3f ms\n",
+           fired, timeDifference(Timestamp::now(), start),
+           totalLate * 1e3 / fired, maxLate * 1e3);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int timers = argc > 1 ? atoi(argv[1]) : 1000 * 1000;
+  printf("timers = %d\n", timers);
+
+  // 到期时间在60秒内均匀分布, 类似每个连接一个空闲/请求超时
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<double> delay(0.0, 60.0);
+  Timestamp now(Timestamp::now());
+  std::vector<Timestamp> whens;
+  whens.reserve(timers);
+  for (int i = 0; i < timers; ++i)
+  {
+    whens.push_back(addTime(now, delay(gen)));
+  }
+
+  benchList<SetTimerList>("std::set", whens, 2);
+  benchList<WheelTimerList>("TimingWheel", whens, 2);
+  benchEventLoop(timers);
+}
@@ -0,0 +1,186 @@
+// MSG_ZEROCOPY发送的CPU开销测试
+// 发送端用TcpClient连续send(Buffer*)大块数据, 统计发送线程每GB消耗的CPU时间(用户态+内核态),
+// 分别测量普通发送和setZeroCopyThreshold()打开后的结果。
+// 每块数据都要新分配并填充, 这部分开销两种模式相同, 单独测出来作为参考(fill only)。
+//
+// 回环接口上内核仍会拷贝一次, 看不出差别; 应该发到另一台机器:
+//   远端: nc -l 9999 > /dev/null   (每种模式各连接一次, 需要能重复接受连接的sink)
+//   本机: zerocopy_bench 4096 1024 远端IP 9999
+// 不指定远端时在本进程内起一个回环sink。
+//
+// usage: zerocopy_bench [megabytes] [chunkKB] [host port]
+
+#include "muduo/base/CountDownLatch.h"
+#include "muduo/base/Thread.h"
+#include "muduo/base/Timestamp.h"
+#include "muduo/net/Buffer.h"
+#include "muduo/net/EventLoop.h"
+#include "muduo/net/EventLoopThread.h"
+#include "muduo/net/InetAddress.h"
+#include "muduo/net/SocketsOps.h"
+#include "muduo/net/TcpClient.h"
+#include "muduo/net/TcpConnection.h"
+
+#include <memory>
+#include <vector>
+
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+
+using namespace muduo;
+using namespace muduo::net;
+
+double threadCpuSeconds()
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+void fillChunk(Buffer* buf, size_t chunk)
+{
+  buf->ensureWritableBytes(chunk);
+  ::memset(buf->beginWrite(), 'x', chunk);
+  buf->hasWritten(chunk);
+}
+
+// 回环sink: 接受连接, 读到对端关闭为止
+class Sink : noncopyable
+{
+ public:
+  Sink()
+    : listenFd_(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)),  // 阻塞的监听socket
+      thread_(std::bind(&Sink::run, this), "sink")
+  {
+    InetAddress addr(0, true);
+    sockets::bindOrDie(listenFd_, addr.getSockAddr());
+    sockets::listenOrDie(listenFd_);
+    port_ = InetAddress(sockets::getLocalAddr(listenFd_)).port();
+    thread_.start();
+  }
+
+  ~Sink()
+  {
+    ::shutdown(listenFd_, SHUT_RDWR);
+    thread_.join();
+    sockets::close(listenFd_);
+  }
+
+  uint16_t port() const { return port_; }
+
+ private:
+  void run()
+  {
+    std::vector<char> buf(1024 * 1024);
+    while (true)
+    {
+      int fd = ::accept(listenFd_, NULL, NULL);
+      if (fd < 0)
+      {
+        break;
+      }
+      while (sockets::read(fd, buf.data(), buf.size()) > 0)
+      {
+      }
+      sockets::close(fd);
+    }
+  }
+
+  int listenFd_;
+  uint16_t port_;
+  Thread thread_;
+};
+
+struct Result
+{
+  double cpu;
+  double wall;
+};
+
+Result benchSend(const InetAddress& peer, size_t total, size_t chunk, size_t zeroCopyThreshold)
+{
+  // 回调引用这些局部变量, 要比loop线程活得久
+  CountDownLatch finished(1);
+  Result result = { 0, 0 };
+  size_t sent = 0;
+  bool done = false;
+  double cpuStart = 0;
+  Timestamp wallStart;
+  EventLoopThread loopThread;
+  EventLoop* loop = loopThread.startLoop();
+
+  TcpClient client(loop, peer, "zerocopy_bench");
+  client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+    if (conn->connected())
+    {
+      conn->setZeroCopyThreshold(zeroCopyThreshold);
+      cpuStart = threadCpuSeconds();
+      wallStart = Timestamp::now();
+      Buffer buf;
+      fillChunk(&buf, chunk);
+      sent += chunk;
+      conn->send(&buf);
+    }
+  });
+  client.setWriteCompleteCallback([&](const TcpConnectionPtr& conn) {
+    if (sent < total)
+    {
+      Buffer buf;
+      fillChunk(&buf, chunk);
+      sent += chunk;
+      conn->send(&buf);
+    }
+    else if (!done)
+    {
+      done = true;
+      result.cpu = threadCpuSeconds() - cpuStart;
+      result.wall = timeDifference(Timestamp::now(), wallStart);
+      conn->shutdown();
+      finished.countDown();
+    }
+  });
+  client.connect();
+  finished.wait();
+  return result;
+}
+
+int main(int argc, char* argv[])
+{
+  size_t megabytes = argc > 1 ? atoi(argv[1]) : 4096;
+  size_t chunk = (argc > 2 ? atoi(argv[2]) : 1024) * 1024;
+  size_t total = megabytes * 1024 * 1024;
+  double gigabytes = static_cast<double>(total) / (1024.0 * 1024 * 1024);
+
+  std::unique_ptr<Sink> sink;
+  InetAddress peer;
+  if (argc > 4)
+  {
+    peer = InetAddress(argv[3], static_cast<uint16_t>(atoi(argv[4])));
+  }
+  else
+  {
+    sink.reset(new Sink);
+    peer = InetAddress(sink->port(), true);
+  }
+  printf("send %zu MiB in %zu KiB chunks to %s\n", megabytes, chunk / 1024, peer.toIpPort().c_str());
+
+  double fillStart = threadCpuSeconds();
+  for (size_t n = 0; n < total; n += chunk)
+  {
+    Buffer buf;
+    fillChunk(&buf, chunk);
+  }
+  double fillCpu = threadCpuSeconds() - fillStart;
+  printf("fill only        : %6.3f cpu s/GB\n", fillCpu / gigabytes);
+
+  Result copy = benchSend(peer, total, chunk, 0);
+  printf("write (copy)     : %6.3f cpu s/GB, %7.1f MB/s\n",
+         copy.cpu / gigabytes, static_cast<double>(megabytes) / copy.wall);
+
+  Result zerocopy = benchSend(peer, total, chunk, 64 * 1024);
+  printf("MSG_ZEROCOPY     : %6.3f cpu s/GB, %7.1f MB/s\n",
+         zerocopy.cpu / gigabytes, static_cast<double>(megabytes) / zerocopy.wall);
+}